@@ -0,0 +1,310 @@
+// Copyright (C) 2018-2021 Lars Magnus Valnes
+//
+// This file is part of Surface Volume Meshing Toolkit (SVM-TK).
+//
+// SVM-Tk is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SVM-Tk is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SVM-Tk.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef Batch_meshing_H
+
+#define Batch_meshing_H
+/* --- Includes -- */
+#include "Errors.h"
+#include "Surface.h"
+#include "Domain.h"
+
+/* -- STL -- */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * \struct
+ *
+ * @brief A meshing job, i.e. the input surfaces, the subdomain map, the mesh criteria,
+ * the optimization stages and the output path of one mesh.
+ *
+ * The surfaces are the given Surface objects followed by the surfaces read from
+ * surface_files. The mesh is created with mesh_resolution, unless cell_size is positive,
+ * in which case the explicit criteria are used, @see Domain::create_mesh.
+ */
+struct Meshing_job
+{
+      std::vector<std::shared_ptr<Surface>> surfaces;
+      std::vector<std::string> surface_files;
+      std::shared_ptr<AbstractMap> map;     // DefaultMap if null
+
+      double mesh_resolution = 0;
+      double edge_size = 0;
+      double cell_size = 0;
+      double facet_size = 0;
+      double facet_angle = 30;
+      double facet_distance = 0;
+      double cell_radius_edge_ratio = 3;
+
+      std::vector<std::string> optimization_stages;  // @see Domain::optimize
+      double optimization_time_budget = 0;
+
+      std::string output_path;              // not saved if empty
+      bool save_1Dfeatures = true;
+      double memory_estimate = 0;           // bytes, estimated from the criteria if 0
+};
+
+/**
+ * \struct
+ *
+ * @brief The outcome of a meshing job.
+ *
+ * The status is "done" or "failed", and error holds the exception message of failed jobs.
+ * The timings in seconds are: wait, load, domain, mesh, optimize, save and total,
+ * where wait is the time spent waiting for memory admission.
+ */
+struct Meshing_job_result
+{
+      std::string status = "pending";
+      std::string error;
+      int number_of_cells = 0;
+      double memory_estimate = 0;
+      Parameters timings;
+};
+
+/**
+ * @brief Estimates the peak memory of meshing a set of surfaces with a job's criteria.
+ *
+ * The number of cells is estimated as the number of regular tetrahedra, with
+ * circumradius equal to the cell size, that fill the bounding sphere of the surfaces.
+ * @param job the meshing job.
+ * @param surfaces the loaded surfaces of the job.
+ * @return the estimated memory in bytes.
+ */
+inline double estimate_meshing_memory(const Meshing_job& job, const std::vector<std::shared_ptr<Surface>>& surfaces)
+{
+   const double bytes_per_cell = 512.0;
+   const double bytes_per_face = 256.0;
+
+   CGAL::Bbox_3 bbox;
+   double faces = 0;
+   for ( auto& surface : surfaces )
+   {
+      const Surface::Mesh& mesh = static_cast<const Surface&>(*surface).get_mesh();
+      if ( !mesh.is_empty() )
+         bbox += CGAL::Polygon_mesh_processing::bbox(mesh);
+      faces += mesh.number_of_faces();
+   }
+   const double radius = 0.5*std::sqrt(CGAL::square(bbox.xmax()-bbox.xmin()) +
+                                       CGAL::square(bbox.ymax()-bbox.ymin()) +
+                                       CGAL::square(bbox.zmax()-bbox.zmin()));
+   const double cell_size = job.cell_size > 0 ? job.cell_size : radius/job.mesh_resolution;
+   if ( !(cell_size > 0) )
+      return 2*faces*bytes_per_face;
+
+   // A regular tetrahedron with circumradius r has volume 8*r^3/(9*sqrt(3)).
+   const double cells = (4.0*M_PI/3.0)*std::pow(radius/cell_size,3)*9.0*std::sqrt(3.0)/8.0;
+   return 2*faces*bytes_per_face + cells*bytes_per_cell;
+}
+
+/**
+ * \class
+ *
+ * @brief Admits jobs while the sum of their memory estimates is within a limit.
+ *
+ * A job is always admitted when no other job is running, such that a job with
+ * an estimate above the limit runs alone instead of blocking forever.
+ */
+class Memory_admission
+{
+   public:
+        /**
+         * @param memory_limit the memory limit in bytes, 0 for no limit.
+         */
+        Memory_admission(double memory_limit) : memory_limit(memory_limit) {}
+
+        /**
+         * @brief Blocks until a job with the memory estimate is admitted.
+         * @param memory the memory estimate of the job in bytes.
+         * @return void
+         */
+        void acquire(double memory)
+        {
+           std::unique_lock<std::mutex> lock(mutex);
+           admitted.wait(lock, [&]() { return running_jobs == 0 or memory_limit == 0 or running_memory + memory <= memory_limit; });
+           running_memory += memory;
+           ++running_jobs;
+        }
+
+        /**
+         * @brief Releases the memory estimate of a finished job.
+         * @param memory the memory estimate of the job in bytes.
+         * @return void
+         */
+        void release(double memory)
+        {
+           {
+              std::lock_guard<std::mutex> lock(mutex);
+              running_memory -= memory;
+              --running_jobs;
+           }
+           admitted.notify_all();
+        }
+
+   private:
+        double memory_limit;
+        double running_memory = 0;
+        int running_jobs = 0;
+        std::mutex mutex;
+        std::condition_variable admitted;
+};
+
+/**
+ * @brief Runs one meshing job, and stores the status and timings in the result.
+ *
+ * Exceptions are caught and reported in the result, such that a failed job
+ * does not affect other jobs.
+ * @param job the meshing job.
+ * @param result the result of the job.
+ * @param admission the memory admission shared by the jobs.
+ * @param threads_per_job the number of threads used by each Domain.
+ * @return void
+ */
+inline void run_meshing_job_(const Meshing_job& job, Meshing_job_result& result, Memory_admission& admission, int threads_per_job)
+{
+   typedef std::chrono::steady_clock Clock;
+   auto seconds = [](Clock::time_point start) { return std::chrono::duration<double>(Clock::now() - start).count(); };
+   const Clock::time_point start = Clock::now();
+   for ( const char* key : {"wait", "load", "domain", "mesh", "optimize", "save"} )
+      result.timings[key] = 0;
+   try
+   {
+      Clock::time_point stage = Clock::now();
+      std::vector<std::shared_ptr<Surface>> surfaces(job.surfaces);
+      for ( auto& file : job.surface_files )
+         surfaces.push_back(std::make_shared<Surface>(file));
+      result.timings["load"] = seconds(stage);
+
+      result.memory_estimate = job.memory_estimate > 0 ? job.memory_estimate : estimate_meshing_memory(job, surfaces);
+      stage = Clock::now();
+      admission.acquire(result.memory_estimate);
+      struct Release
+      {
+         Memory_admission& admission;
+         double memory;
+         ~Release() { admission.release(memory); }
+      } release{admission, result.memory_estimate};
+      result.timings["wait"] = seconds(stage);
+
+      stage = Clock::now();
+      std::unique_ptr<Domain> domain;
+      if ( job.map )
+         domain.reset(new Domain(surfaces, job.map));
+      else
+         domain.reset(new Domain(surfaces));
+      domain->set_number_of_threads(threads_per_job);
+      surfaces.clear();
+      result.timings["domain"] = seconds(stage);
+
+      stage = Clock::now();
+      if ( job.cell_size > 0 )
+         domain->create_mesh(job.edge_size, job.cell_size, job.facet_size, job.facet_angle, job.facet_distance, job.cell_radius_edge_ratio);
+      else
+         domain->create_mesh(job.mesh_resolution);
+      result.timings["mesh"] = seconds(stage);
+
+      stage = Clock::now();
+      if ( !job.optimization_stages.empty() )
+         domain->optimize(job.optimization_stages, job.optimization_time_budget);
+      result.timings["optimize"] = seconds(stage);
+
+      stage = Clock::now();
+      if ( !job.output_path.empty() )
+         domain->save(job.output_path, job.save_1Dfeatures);
+      result.timings["save"] = seconds(stage);
+
+      result.number_of_cells = domain->number_of_cells();
+      result.status = "done";
+   }
+   catch ( const std::exception& e )
+   {
+      result.status = "failed";
+      result.error = e.what();
+   }
+   catch ( ... )
+   {
+      result.status = "failed";
+      result.error = "Unknown error.";
+   }
+   result.timings["total"] = seconds(start);
+}
+
+/**
+ * @brief Runs independent meshing jobs concurrently on a bounded pool of worker threads.
+ *
+ * Each job has its own Domain, and a failed job is reported in its result without
+ * affecting the other jobs. A job is admitted to mesh only if its memory estimate
+ * fits within the memory limit together with the running jobs, except that a job
+ * is always admitted when no other job is running.
+ * The jobs must not share a subdomain map, since the map is frozen by each Domain.
+ *
+ * @param jobs the meshing jobs.
+ * @param number_of_workers the number of concurrent jobs, 0 uses the number of cores.
+ * @param memory_limit the total memory estimate of running jobs in bytes, 0 for no limit.
+ * @param threads_per_job the number of threads used by each Domain, @see Domain::set_number_of_threads.
+ * @return the results of the jobs, in the order of the jobs.
+ * @throws InvalidArgumentError if the arguments are invalid, a job has no surfaces or mesh criteria,
+ *         or two jobs share a subdomain map.
+ */
+inline std::vector<Meshing_job_result> run_meshing_jobs(const std::vector<Meshing_job>& jobs, int number_of_workers = 1,
+                                                        double memory_limit = 0, int threads_per_job = 1)
+{
+   if ( number_of_workers < 0 or threads_per_job < 0 or memory_limit < 0 )
+      throw InvalidArgumentError("Number of workers, threads per job and memory limit must be non-negative.");
+
+   std::set<const AbstractMap*> maps;
+   for ( auto& job : jobs )
+   {
+      if ( job.surfaces.empty() and job.surface_files.empty() )
+         throw InvalidArgumentError("Meshing job has no surfaces.");
+      if ( !(job.mesh_resolution > 0) and !(job.cell_size > 0) )
+         throw InvalidArgumentError("Meshing job needs a positive mesh resolution or cell size.");
+      if ( job.map and !maps.insert(job.map.get()).second )
+         throw InvalidArgumentError("Meshing jobs must not share a subdomain map.");
+   }
+
+   if ( number_of_workers == 0 )
+      number_of_workers = std::max(1u, std::thread::hardware_concurrency());
+   number_of_workers = static_cast<int>(std::min<std::size_t>(number_of_workers, jobs.size()));
+
+   Memory_admission admission(memory_limit);
+   std::vector<Meshing_job_result> results(jobs.size());
+   std::atomic<std::size_t> next(0);
+   std::vector<std::thread> workers;
+   for ( int i = 0; i < number_of_workers; ++i )
+   {
+      workers.emplace_back([&]()
+      {
+         for ( std::size_t j = next++; j < jobs.size(); j = next++ )
+            run_meshing_job_(jobs[j], results[j], admission, threads_per_job);
+      });
+   }
+   for ( auto& worker : workers )
+      worker.join();
+   return results;
+}
+
+#endif
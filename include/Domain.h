@@ -20,6 +20,10 @@
 
 /* --- Includes -- */
 #include "Polyhedral_vector_to_labeled_function_wrapper.h"
+#include "Medit.h"
+#include "XDMF.h"
+#include "Parallel.h"
+#include "Mesh_quality.h"
 
 /* -- CGAL Bounding Volumes -- */
 #include <CGAL/Min_sphere_of_spheres_d.h>
@@ -27,18 +31,40 @@
 
 /* -- CGAL 3D Mesh Generation-- */ 
 #include <CGAL/Mesh_polyhedron_3.h>
+#include <CGAL/Surface_mesh.h>
+#include <CGAL/Polyhedral_mesh_domain_3.h>
 #include <CGAL/Polyhedral_mesh_domain_with_features_3.h>
+#include <CGAL/Polygon_mesh_processing/orientation.h>
 #include <CGAL/Labeled_mesh_domain_3.h>
 #include <CGAL/Mesh_domain_with_polyline_features_3.h>
 #include <CGAL/Mesh_triangulation_3.h>
 #include <CGAL/Mesh_complex_3_in_triangulation_3.h>
 #include <CGAL/Mesh_criteria_3.h>
 #include <CGAL/make_mesh_3.h>
+#include <CGAL/refine_mesh_3.h>
+#include <CGAL/IO/File_binary_mesh_3.h>
+
+/* -- CGAL Parallel Mesh_3 -- */
+#ifdef CGAL_LINKED_WITH_TBB
+#include <CGAL/Mesh_3/Concurrent_mesher_config.h>
+#endif
 
 /* -- CGAL Mesh_3 -- */ 
 #include <CGAL/Mesh_3/Detect_polylines_in_polyhedra.h>
 #include <CGAL/Mesh_3/polylines_to_protect.h>
 
+/* -- CGAL AABB -- */
+#include <CGAL/AABB_tree.h>
+#include <CGAL/AABB_traits.h>
+#include <CGAL/AABB_segment_primitive.h>
+
+/* -- STL -- */
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+
 /**
  * @brief Transform facets with a specific tag to points and facet connections.
  *
@@ -114,6 +140,132 @@ void facets_in_complex_3_to_triangle_soup_(const C3T3& c3t3,
   }
 }
 
+/**
+ * @brief Transform a set of mesh facets to points and facet connections, where 
+ * face i of the output is facet i of the input.
+ *
+ * The vertices are oriented as in c3t3_to_medit_mesh_.
+ * 
+ * @param[in] c3t3 the mesh srtucture stored in the Domain class Obejct
+ * @param[in] facets vector of facets. 
+ * @param[out] points vector of points 
+ * @param[out] faces vector of faces, i.e. std::vector<std::size_t> with 3 elements.
+ * 
+ * @relatesalso SVMTK Domain class.
+ */
+template<class C3T3, class FacetContainer, class PointContainer, class FaceContainer>
+void facets_to_triangle_soup_(const C3T3& c3t3,
+                              const FacetContainer& facets,
+                              PointContainer& points,
+                              FaceContainer& faces)
+{
+  typedef typename PointContainer::value_type         Point_3;
+  typedef typename FaceContainer::value_type          Face;
+  typedef typename C3T3::Triangulation                Tr;
+  typedef typename Tr::Vertex_handle                  Vertex_handle;
+  typedef typename Tr::Weighted_point                 Weighted_point;
+
+  typedef CGAL::Hash_handles_with_or_without_timestamps                  Hash_fct;
+  typedef boost::unordered_map<Vertex_handle, std::size_t, Hash_fct>     VHmap;
+
+  faces.reserve(faces.size() + facets.size());
+  points.reserve(points.size() + facets.size()/2); 
+  VHmap vh_to_ids;
+  for ( auto& facet : facets )
+  {
+    Face f;
+    CGAL::Mesh_3::internal::resize(f, 3);
+    for(std::size_t i=1; i<4; ++i)
+    {
+      const int j = (facet.second + i)&3;
+      auto map_entry = vh_to_ids.insert(std::make_pair(facet.first->vertex(j), points.size()));
+      if ( map_entry.second )
+      {
+        const Weighted_point& p = c3t3.triangulation().point(facet.first, j);
+        points.push_back(Point_3(CGAL::to_double(p.x()), CGAL::to_double(p.y()), CGAL::to_double(p.z())));
+      }
+      f[i-1] = map_entry.first->second;
+    }
+    if ( facet.second % 2 != 0 )
+        std::swap(f[1], f[2]);
+    faces.push_back(f);
+  }
+}
+
+/**
+ * @brief Returns the largest time stamp of the finite vertices in a triangulation, 
+ * used to size vectors that are indexed by the vertex time stamp.
+ *
+ * @param tr the triangulation.
+ * @return the largest vertex time stamp, or 0 if there are no vertices.
+ *
+ * @relatesalso SVMTK Domain class.
+ */
+template<class Tr>
+std::size_t max_vertex_time_stamp_(const Tr& tr)
+{
+  std::size_t max_time_stamp = 0;
+  for( auto vit = tr.finite_vertices_begin(); vit != tr.finite_vertices_end(); ++vit)
+    max_time_stamp = std::max(max_time_stamp, vit->time_stamp());
+  return max_time_stamp;
+}
+
+/**
+ * @brief Transform the facets of several surface patches to points and facet 
+ * connections in one pass, with one vertex numbering shared by all patches.
+ *
+ * The faces are oriented as in facets_in_complex_3_to_triangle_soup_.
+ * 
+ * @param[in] c3t3 the mesh srtucture stored in the Domain class Obejct
+ * @param[in] patch_facets map from surface patch tag to the facets of the patch. 
+ * @param[out] points vector of points shared by all patches. 
+ * @param[out] patch_faces vector with the faces of each patch, in the order of patch_facets.
+ * 
+ * @relatesalso SVMTK Domain class.
+ */
+template<class C3T3, class PatchFacetMap, class PointContainer, class FaceContainer>
+void patch_facets_to_triangle_soups_(const C3T3& c3t3,
+                                     const PatchFacetMap& patch_facets,
+                                     PointContainer& points,
+                                     std::vector<FaceContainer>& patch_faces)
+{
+  typedef typename PointContainer::value_type         Point_3;
+  typedef typename FaceContainer::value_type          Face;
+  typedef typename C3T3::Triangulation                Tr;
+  typedef typename Tr::Weighted_point                 Weighted_point;
+
+  const Tr& tr = c3t3.triangulation();
+  std::vector<std::size_t> V(max_vertex_time_stamp_(tr) + 1, std::numeric_limits<std::size_t>::max());
+
+  patch_faces.reserve(patch_faces.size() + patch_facets.size());
+  for ( auto& patch : patch_facets )
+  {
+    FaceContainer faces;
+    faces.reserve(patch.second.size());
+    for ( auto& facet : patch.second )
+    {
+      Face f;
+      CGAL::Mesh_3::internal::resize(f, 3);
+      for(std::size_t i=1; i<4; ++i)
+      {
+        const int j = (facet.second + i)&3;
+        std::size_t& id = V[facet.first->vertex(j)->time_stamp()];
+        if ( id == std::numeric_limits<std::size_t>::max() )
+        {
+          const Weighted_point& p = tr.point(facet.first, j);
+          id = points.size();
+          points.push_back(Point_3(CGAL::to_double(p.x()), CGAL::to_double(p.y()), CGAL::to_double(p.z())));
+        }
+        f[i-1] = id;
+      }
+      if( patch.first.first < patch.first.second)
+        std::swap(f[0], f[1]);
+      faces.push_back(f);
+    }
+    patch_faces.push_back(std::move(faces));
+  }
+}
+
 /** 
  * TODO : Improve compilation
  *  @brief Writes the stored mesh to a medit file.
@@ -132,6 +284,8 @@ void facets_in_complex_3_to_triangle_soup_(const C3T3& c3t3,
  *  @param print_each_facet_twice
  *  @param save_edges 
  *  @return none, write mesh to textfile with extension .mesh.
+ *  @note Domain::save uses c3t3_to_medit_mesh_ and write_medit_ascii, this 
+ *  function is kept for comparison.
 */
 template <class C3T3,
           class Vertex_index_property_map,
@@ -221,7 +375,7 @@ void output_to_medit_(std::ostream& os,
          {         
             Vertex_handle vh1 = eit->first->vertex(eit->second);
             Vertex_handle vh2 = eit->first->vertex(eit->third);
-            os << V[vh1] << " " << V[vh2]  <<" " << c3t3.curve_index(*eit) << std::endl;
+            os << V[vh1] << " " << V[vh2]  <<" " << c3t3.curve_index(*eit) << '\n';
          }
      }
   }
@@ -283,12 +437,197 @@ void output_to_medit_(std::ostream& os,
   os << "End\n";
 }
 
+/**
+ *  @brief Flags the vertices of the cells in the mesh complex.
+ *
+ *  CGAL keeps vertices in the triangulation that are not part of any cell 
+ *  in the mesh complex. The flags are indexed by the vertex time stamp, and 
+ *  are used to skip these isolated vertices without changing the triangulation.
+ *
+ *  @param c3t3 the mesh structure stored in the Domain class Obejct
+ *  @param number_of_connected is set to the number of flagged vertices. 
+ *  @return flags vector with 1 for vertices of cells in the complex, indexed by time stamp.
+ */
+template <class C3T3>
+std::vector<char> connected_vertex_flags_(const C3T3& c3t3, std::size_t& number_of_connected)
+{
+  std::vector<char> connected(max_vertex_time_stamp_(c3t3.triangulation()) + 1, 0);
+  number_of_connected = 0;
+  for( auto cit = c3t3.cells_in_complex_begin() ; cit != c3t3.cells_in_complex_end() ; ++cit )
+  {
+    for ( int i = 0; i < 4; ++i )
+    {
+      char& flag = connected[cit->vertex(i)->time_stamp()];
+      number_of_connected += !flag;
+      flag = 1;
+    }
+  }
+  return connected;
+}
+
+/** 
+ *  @brief Exports the stored mesh to flat vertex, edge, triangle and tetrahedron 
+ *  arrays with tags, that are serialized by the mesh writers.
+ *
+ *  The tags and the triangle orientation are the same as in output_to_medit_, 
+ *  but the complex is traversed once: 
+ *  - vertices are numbered in a vector indexed by the vertex time stamp, and 
+ *    vertices that are not part of a cell in the complex are skipped, 
+ *  - each cell in the complex gives its tetrahedron, its facets that are not 
+ *    shared with a cell in the complex with a smaller handle, and its six edges,
+ *  - the edges are made unique by sorting the vertex index pairs.
+ *  The cells are processed in parallel if SVMTK is built with TBB.
+ *
+ *  @param c3t3 the mesh structure stored in the Domain class Obejct
+ *  @param vertex_pmap 
+ *  @param facet_pmap map from pair of subdomain tags to interface tag.
+ *  @param cell_pmap
+ *  @param save_edges 
+ *  @return mesh the mesh with tags and zero based vertex indices. 
+*/
+template <class C3T3,
+          class Vertex_index_property_map,
+          typename Facet_index_property_map,
+          class Cell_index_property_map>
+Medit_mesh c3t3_to_medit_mesh_(const C3T3& c3t3,
+                const Vertex_index_property_map& vertex_pmap,
+                const Facet_index_property_map& facet_pmap,
+                const Cell_index_property_map& cell_pmap,
+                const bool save_edges = true )
+{
+  typedef typename C3T3::Triangulation Tr;
+  typedef typename C3T3::Surface_patch_index Surface_patch_index;
+  typedef typename Tr::Vertex_handle Vertex_handle;
+  typedef typename Tr::Cell_handle Cell_handle;
+  typedef typename Tr::Edge Edge;
+
+  const Tr& tr = c3t3.triangulation();
+  Medit_mesh mesh;
+
+  // Vertices, sequential since the vertex pmap may traverse the incident cells.
+  std::size_t number_of_connected;
+  std::vector<char> connected = connected_vertex_flags_(c3t3, number_of_connected);
+
+  std::vector<int> V(connected.size(), -1);
+  mesh.vertices.reserve(3*number_of_connected);
+  mesh.vertex_tags.reserve(number_of_connected);
+  int inum = 0;
+  for( auto vit = tr.finite_vertices_begin(); vit != tr.finite_vertices_end(); ++vit)
+  {
+    if ( !connected[vit->time_stamp()] )
+      continue;
+    V[vit->time_stamp()] = inum++;
+    auto p = tr.point(vit);
+    mesh.vertices.push_back(CGAL::to_double(p.x()));
+    mesh.vertices.push_back(CGAL::to_double(p.y()));
+    mesh.vertices.push_back(CGAL::to_double(p.z()));
+    mesh.vertex_tags.push_back(get(vertex_pmap, vit));
+  }
+  auto index = [&V](const Vertex_handle& vh) { return V[vh->time_stamp()]; };
+
+  std::vector<Cell_handle> cells;
+  cells.reserve(c3t3.number_of_cells_in_complex());
+  for( auto cit = c3t3.cells_in_complex_begin() ; cit != c3t3.cells_in_complex_end() ; ++cit )
+    cells.push_back(cit);
+  const std::size_t number_of_cells = cells.size();
+
+  // A facet is written by the cell in the complex with the smallest handle.
+  auto owns_facet = [&c3t3](const Cell_handle& c, int i)
+  {
+    Cell_handle n = c->neighbor(i);
+    return !c3t3.is_in_complex(n) or c < n;
+  };
+
+  std::vector<std::size_t> facet_offsets(number_of_cells + 1, 0);
+  parallel_for_each_index(number_of_cells, [&](std::size_t k)
+  {
+    std::size_t count = 0;
+    for ( int i = 0; i < 4; ++i )
+      count += owns_facet(cells[k], i);
+    facet_offsets[k+1] = count;
+  });
+  for ( std::size_t k = 0; k < number_of_cells; ++k )
+    facet_offsets[k+1] += facet_offsets[k];
+
+  mesh.tetrahedra.resize(4*number_of_cells);
+  mesh.tetrahedron_tags.resize(number_of_cells);
+  mesh.triangles.resize(3*facet_offsets[number_of_cells]);
+  mesh.triangle_tags.resize(facet_offsets[number_of_cells]);
+
+  typedef std::pair<std::pair<int,int>,Edge> Indexed_edge;
+  std::vector<Indexed_edge> edges(save_edges ? 6*number_of_cells : 0);
+
+  parallel_for_each_index(number_of_cells, [&](std::size_t k)
+  {
+    const Cell_handle& c = cells[k];
+    for ( int i = 0; i < 4; ++i )
+      mesh.tetrahedra[4*k+i] = index(c->vertex(i));
+    mesh.tetrahedron_tags[k] = get(cell_pmap, c);
+
+    std::size_t t = facet_offsets[k];
+    for ( int i = 0; i < 4; ++i )
+    {
+      if ( !owns_facet(c, i) )
+        continue;
+      typename C3T3::Facet f(c, i);
+      if (f.first->subdomain_index() > f.first->neighbor(f.second)->subdomain_index())
+        f = tr.mirror_facet(f);
+      int v1 = index(f.first->vertex((f.second + 1) % 4));
+      int v2 = index(f.first->vertex((f.second + 2) % 4));
+      int v3 = index(f.first->vertex((f.second + 3) % 4));
+      if (f.second % 2 != 0)
+        std::swap(v2, v3);
+      mesh.triangles[3*t]   = v1;
+      mesh.triangles[3*t+1] = v2;
+      mesh.triangles[3*t+2] = v3;
+
+      Surface_patch_index spi = c3t3.surface_patch_index(c, i);
+      std::pair<int,int> key(static_cast<int>(spi.first) , static_cast<int>(spi.second) );
+      if ( key.second> key.first){std::swap(key.first,key.second);}
+      auto tag = facet_pmap.find(key);
+      mesh.triangle_tags[t++] = ( tag == facet_pmap.end() ? 0 : tag->second );
+    }
+
+    if ( save_edges )
+    {
+      std::size_t e = 6*k;
+      for ( int i = 0; i < 3; ++i )
+      {
+        for ( int j = i+1; j < 4; ++j )
+        {
+          int a = mesh.tetrahedra[4*k+i];
+          int b = mesh.tetrahedra[4*k+j];
+          edges[e++] = Indexed_edge(std::make_pair(std::min(a,b), std::max(a,b)), Edge(c, i, j));
+        }
+      }
+    }
+  });
+
+  if ( save_edges )
+  {
+    parallel_sort(edges.begin(), edges.end(), [](const Indexed_edge& x, const Indexed_edge& y) { return x.first < y.first; });
+    edges.erase(std::unique(edges.begin(), edges.end(), [](const Indexed_edge& x, const Indexed_edge& y) { return x.first == y.first; }), edges.end());
+    mesh.edges.resize(2*edges.size());
+    mesh.edge_tags.resize(edges.size());
+    parallel_for_each_index(edges.size(), [&](std::size_t k)
+    {
+      mesh.edges[2*k]   = edges[k].first.first;
+      mesh.edges[2*k+1] = edges[k].first.second;
+      mesh.edge_tags[k] = static_cast<int>(c3t3.curve_index(edges[k].second));
+    });
+  }
+  return mesh;
+}
+
 /**
  * \struct
  *
  * @brief Used to store surface points and compute 
  *        the minimum bounding radius required to 
  *        enclose all of the added surface points. 
+ *
+ * The points are inserted directly in the CGAL minimum sphere, which is 
+ * reduced to its support points once the radius is computed. 
  */
 template<typename Kernel>
 struct Minimum_sphere
@@ -307,22 +646,144 @@ struct Minimum_sphere
            {
                 for (typename MeshPolyhedron_3::Vertex_const_iterator it=polyhedron.vertices_begin();it != polyhedron.vertices_end(); ++it)
                 {
-                    S.push_back(Sphere(it->point(), 0.0));
+                    ms.insert(Sphere(it->point(), 0.0));
+                }
+                computed = false;
+            } 
+
+           /**
+            * @brief Adds the vertices of a surface mesh to the struct  
+            * @param mesh triangulated surface mesh.
+            * @return none 
+            */            
+           template< typename SurfaceMesh>  
+           void add_mesh(const SurfaceMesh &mesh)
+           {
+                for ( auto vertex : mesh.vertices() )
+                {
+                    ms.insert(Sphere(mesh.point(vertex), 0.0));
                 }
+                computed = false;
             } 
 
            /**
-            * @brief Computes the minimum bounding radius required to enclose the added surface points
+            * @brief Computes the minimum bounding radius required to enclose the added surface points, 
+            * and keeps only the support points of the sphere. The radius is exact if all points 
+            * are added before the first call. 
+            * @param none   
+            * @return none
+            */
+           void compute()
+           {
+               if ( ms.is_empty() )
+                  return;
+               radius = CGAL::to_double(ms.radius());
+               std::vector<Sphere> support(ms.support_begin(), ms.support_end());
+               ms.clear();
+               ms.insert(support.begin(), support.end());
+               computed = true;
+           }
+
+           /**
+            * @brief Returns the minimum bounding radius required to enclose the added surface points
             * @param none   
             * @return the radius that encloses all added surface points  
             */
            double get_bounding_sphere_radius()
            {
-               Min_sphere ms(S.begin(), S.end());
-               return CGAL::to_double(ms.radius());
+               if ( !computed )
+                  compute();
+               return radius;
            }
            private:
-                 std::vector<Sphere> S;
+                 Min_sphere ms;
+                 double radius = 0.0;
+                 bool computed = false;
+};
+
+/**
+ * \struct
+ *
+ * @brief Mesh sizes for subdomain tags, interfaces given by a pair of subdomain tags, 
+ * and curve tags, set by Domain::set_subdomain_size, Domain::set_interface_size and 
+ * Domain::set_curve_size.
+ */
+struct Mesh_sizes
+{
+      std::map<int,double> subdomains;                 // cell size
+      std::map<std::pair<int,int>,double> interfaces;  // facet size
+      std::map<int,double> curves;                     // edge size
+
+      bool empty() const { return subdomains.empty() and interfaces.empty() and curves.empty(); }
+};
+
+/**
+ * \class
+ *
+ * @brief Mesh sizing field given by the tag of the mesh element, used as cell_size, 
+ * facet_size and edge_size in the mesh criteria. 
+ *
+ * The size of 
+ * - a cell is the size of its subdomain, 
+ * - a facet is the size of its interface, otherwise the smallest size of the two 
+ *   adjacent subdomains,
+ * - an edge is the size of its curve, 
+ * and the default size if no size is set. A default size of 0 means no bound, 
+ * as for the constant mesh criteria, and is replaced by the largest double.
+ *
+ * @tparam MeshDomain the CGAL mesh domain with features.
+ */
+template<typename MeshDomain>
+class Tag_sizing_field
+{
+   public:
+        typedef typename MeshDomain::FT FT;
+        typedef typename MeshDomain::Index Index;
+
+        Tag_sizing_field(const MeshDomain& domain, std::shared_ptr<const Mesh_sizes> sizes, double default_size) 
+                        : domain(&domain), sizes(sizes), 
+                          default_size(default_size > 0 ? default_size : std::numeric_limits<double>::max()) {}
+
+        template<typename Point>
+        FT operator()(const Point&, const int dimension, const Index& index) const
+        {
+           if ( dimension == 3 )
+              return find(sizes->subdomains, static_cast<int>(domain->subdomain_index(index)));
+           if ( dimension == 2 )
+           {
+              auto spi = domain->surface_patch_index(index);
+              int i = static_cast<int>(spi.first); 
+              int j = static_cast<int>(spi.second);
+              auto it = sizes->interfaces.find(std::make_pair(i,j));
+              if ( it == sizes->interfaces.end() )
+                 it = sizes->interfaces.find(std::make_pair(j,i));
+              if ( it != sizes->interfaces.end() )
+                 return it->second;
+              auto si = sizes->subdomains.find(i);
+              auto sj = sizes->subdomains.find(j);
+              if ( si == sizes->subdomains.end() and sj == sizes->subdomains.end() )
+                 return default_size; 
+              if ( si == sizes->subdomains.end() )
+                 return sj->second;
+              if ( sj == sizes->subdomains.end() )
+                 return si->second;
+              return std::min(si->second, sj->second);
+           }
+           if ( dimension == 1 )
+              return find(sizes->curves, static_cast<int>(domain->curve_index(index)));
+           return default_size;
+        }
+
+   private:
+        FT find(const std::map<int,double>& map, int tag) const
+        {
+           auto it = map.find(tag);
+           return it == map.end() ? default_size : it->second;
+        }
+
+        const MeshDomain* domain;
+        std::shared_ptr<const Mesh_sizes> sizes;
+        double default_size;
 };
 
 
@@ -343,14 +804,19 @@ class Domain {
         typedef Kernel::FT FT;
         typedef CGAL::Mesh_polyhedron_3<Kernel>::type Polyhedron; 
         
-        typedef CGAL::Polyhedral_mesh_domain_with_features_3<Kernel, Polyhedron> Polyhedral_mesh_domain_3; 
+        typedef CGAL::Surface_mesh<Point_3> Surface_mesh;
+        typedef CGAL::Polyhedral_mesh_domain_3<Surface_mesh, Kernel> Polyhedral_mesh_domain_3; 
         typedef CGAL::Polyhedral_vector_to_labeled_function_wrapper<Polyhedral_mesh_domain_3, Kernel  > Function_wrapper; 
 
         typedef Function_wrapper::Function_vector Function_vector; 
         typedef CGAL::Labeled_mesh_domain_3<Kernel> Labeled_Mesh_Domain;
         typedef CGAL::Mesh_domain_with_polyline_features_3<Labeled_Mesh_Domain> Mesh_domain; 
 
+#ifdef CGAL_LINKED_WITH_TBB
+        typedef CGAL::Parallel_tag Concurrency_tag;
+#else
         typedef CGAL::Sequential_tag Concurrency_tag;
+#endif
 
         typedef CGAL::Mesh_triangulation_3<Mesh_domain,CGAL::Default,Concurrency_tag>::type Tr;
 
@@ -367,8 +833,6 @@ class Domain {
         typedef C3t3::Facets_in_complex_iterator Facet_iterator;
         
         typedef CGAL::Mesh_criteria_3<Tr> Mesh_criteria;
-        typedef CGAL::Mesh_constant_domain_field_3<Tr::Geom_traits,
-                                           Mesh_domain::Index> Sizing_field;
         typedef CGAL::Triple<Cell_handle, int, int> Edge; 
 
         typedef Tr::Finite_vertices_iterator Finite_vertices_iterator;
@@ -381,21 +845,46 @@ class Domain {
         typedef std::map<std::string, double> Parameters;     
         typedef std::vector<std::size_t>  Face; 
 
+        typedef Kernel::Segment_3 Segment_3;
+        typedef std::vector<Segment_3> Segments;
+        typedef CGAL::AABB_segment_primitive<Kernel, Segments::const_iterator> Segment_primitive;
+        typedef CGAL::AABB_traits<Kernel, Segment_primitive> Segment_traits;
+        typedef CGAL::AABB_tree<Segment_traits> Segment_tree;
 
 
 
+
+        template<typename Surface>
+        Domain(const Surface& surface,double error=1.e-7);
         template<typename Surface>
-        Domain(Surface& surface,double error=1.e-7);
+        Domain(const std::vector<Surface>& surfaces,double error=1.e-7);
         template<typename Surface>
-        Domain(std::vector<Surface> surfaces,double error=1.e-7);
+        Domain(const std::vector<Surface>& surfaces, std::shared_ptr<AbstractMap> map,  double error=1.e-7);
         template<typename Surface>
-        Domain(std::vector<Surface> surfaces, std::shared_ptr<AbstractMap> map,  double error=1.e-7);
+        Domain(const std::vector<std::shared_ptr<Surface>>& surfaces,double error=1.e-7);
+        template<typename Surface>
+        Domain(const std::vector<std::shared_ptr<Surface>>& surfaces, std::shared_ptr<AbstractMap> map,  double error=1.e-7);
 
         ~Domain() { for( auto vit : this->v){delete vit;}v.clear();}        
 
         void create_mesh(const double mesh_resolution );
         void create_mesh(double edge_size,double cell_size, double facet_size,double facet_angle,  double facet_distance,double cell_radius_edge_ratio);
-        void save(std::string outpath, bool save_1Dfeatures); 
+
+        void refine(const double mesh_resolution);
+        void refine(double edge_size,double cell_size, double facet_size,double facet_angle,  double facet_distance,double cell_radius_edge_ratio);
+        void save(std::string outpath, bool save_1Dfeatures, int binary_version=3); 
+        void save_xdmf(std::string outpath, int compression_level=0, std::size_t chunk_size=0, bool include_interior_facets=false);
+        Medit_mesh export_mesh(bool save_1Dfeatures=true);
+
+        void save_checkpoint(std::string outpath);
+        void load_checkpoint(std::string inpath);
+
+        /**
+         * @brief Returns the mesh complex stored in the class member variable c3t3.
+         * @param none
+         * @return c3t3 the mesh complex in the triangulation.
+         */
+        const C3t3& get_mesh() const { return c3t3; }
 
         /**
         * @breif Returns the minimum bounding sphere for all added surfaces in the constructor 
@@ -404,6 +893,24 @@ class Domain {
         */
         double get_bounding_sphere_radius(){ return min_sphere.get_bounding_sphere_radius(); }
 
+        void set_number_of_threads(int number_of_threads);
+
+        /**
+         * @brief Returns the number of threads used by the meshing and optimization functions.
+         * @param none
+         * @return the number of threads, where 0 means all available cores.
+         */
+        int get_number_of_threads() { return num_threads; }
+
+        void enable_oracle_statistics(bool enable=true);
+        Parameters get_oracle_statistics();
+
+        void set_subdomain_size(int tag, double cell_size);
+        void set_interface_size(std::pair<int,int> interface, double facet_size);
+        void set_curve_size(int tag, double edge_size);
+        void clear_sizes() { sizes = std::make_shared<Mesh_sizes>(); }
+        Parameters get_sizing_report() { return sizing_report; }
+
         void add_sharp_border_edges(Polyhedron& polyhedron, double threshold);
         template<typename Surface>
         void add_sharp_border_edges(Surface& surface, double threshold=60);
@@ -421,6 +928,36 @@ class Domain {
         std::set<int>  get_subdomains(); 
         std::set<int> get_curves();
 
+        /**
+         * \struct
+         *
+         * @brief Index of the mesh complex by tag, with the number of cells of each 
+         * subdomain, the facets of each surface patch and the edges of each curve.
+         * Each facet is stored once, by a cell in the complex. 
+         */
+        struct Complex_index
+        {
+               std::map<int,std::size_t> subdomain_cells;
+               std::map<std::pair<int,int>,std::vector<Facet>> patch_facets;
+               std::map<int,std::vector<Edge>> curve_edges;
+               bool has_non_curve_edges = false;
+               std::size_t number_of_vertices = 0;
+        };
+
+        const Complex_index& get_complex_index();
+
+        /**
+         * @brief Marks the cached complex index as outdated, such that it is rebuilt 
+         * on the next query. Called by all functions that change the mesh complex.
+         * @param none
+         * @return void
+         */
+        void invalidate_complex_index() { complex_index_valid = false; }
+
+        std::map<int,int> get_subdomain_cell_counts();
+
+        std::map<int,std::vector<Facet>> get_subdomain_boundary_facets();
+
         // FIXME
        template<typename Surface, typename Plane_3>
        void add_sharp_border_edges(Surface& surface,Plane_3 plane); // add const
@@ -434,15 +971,15 @@ class Domain {
          * number_of_surfaces() returns number surfaces used as input    
          * number_of_cells() returns number of cells in 3D mesh object c3t3;
          * number_of_facets() returns number of facets in 3D mesh object c3t3;
-         * number_of_vertices() returns number of vertices in the triangulation of 
-                                the 3D mesh object c3t3;        
+         * number_of_vertices() returns number of vertices of the cells in the 
+                                3D mesh object c3t3, isolated vertices are not counted;        
          */
-        int number_of_subdomains(){return get_subdomains().size() ;}
-        int number_of_curves(){return get_curves().size() ;}
-        int number_of_patches(){return get_patches().size() ;} 
+        int number_of_subdomains(){return get_complex_index().subdomain_cells.size() ;}
+        int number_of_curves(){return get_complex_index().curve_edges.size() + get_complex_index().has_non_curve_edges ;}
+        int number_of_patches(){return get_complex_index().patch_facets.size() ;} 
         int number_of_cells(){return c3t3.number_of_cells();}
         int number_of_facets(){return c3t3.number_of_facets();}
-        int number_of_vertices(){return c3t3.triangulation().number_of_vertices();}       
+        int number_of_vertices(){return get_complex_index().number_of_vertices;}       
         int number_of_surfaces(){return v.size();}
         
         void remove_subdomain(std::vector<int> tags);
@@ -451,14 +988,14 @@ class Domain {
         void set_borders();
         void set_features();
 
-        void clear_borders(){this->borders.clear();}
-        void clear_features(){this->features.clear();}
+        void clear_borders(){this->borders.clear(); invalidate_edge_index();}
+        void clear_features(){this->features.clear(); invalidate_edge_index();}
 
         void add_border(Polyline_3 polyline) { borders.push_back(polyline);} 
         void add_feature(Polyline_3 polyline){ features.push_back(polyline);} 
 
-        Polylines& get_features() {return features; }  
-        Polylines& get_borders() {return borders; }
+        const Polylines& get_features() const {return features; }  
+        const Polylines& get_borders() const {return borders; }
         
         void lloyd(double time_limit= 0, int max_iteration_number = 0, double convergence = 0.02,double freeze_bound = 0.01, bool do_freeze = true);
         void odt(double time_limit= 0, int max_iteration_number = 0, double convergence = 0.02,double freeze_bound = 0.01, bool do_freeze = true); 
@@ -470,7 +1007,7 @@ class Domain {
          * @param sliver_bound 
          * @return none 
          */
-        void exude(double time_limit = 0, double sliver_bound = 0 ){ assert_non_empty_mesh_object(); CGAL::exude_mesh_3(c3t3, sliver_bound=sliver_bound, time_limit=time_limit);} 
+        void exude(double time_limit = 0, double sliver_bound = 0 ){ assert_non_empty_mesh_object(); run_with_threads([&](){ CGAL::exude_mesh_3(c3t3, sliver_bound=sliver_bound, time_limit=time_limit);}); invalidate_complex_index();} 
         
         /**
          * @brief CGAL function for perturb optimazation of the constructed mesh.  
@@ -479,10 +1016,24 @@ class Domain {
          * @param sliver_bound 
          * @return none 
          */
-        void perturb(double time_limit=0, double sliver_bound=0){assert_non_empty_mesh_object(); CGAL::perturb_mesh_3 ( c3t3, *domain_ptr.get(), time_limit=time_limit, sliver_bound=sliver_bound) ;} 
+        void perturb(double time_limit=0, double sliver_bound=0){assert_non_empty_mesh_object(); run_with_threads([&](){ CGAL::perturb_mesh_3 ( c3t3, *domain_ptr.get(), time_limit=time_limit, sliver_bound=sliver_bound) ;}); invalidate_complex_index();} 
+
+        std::vector<std::pair<std::string,Parameters>> optimize(std::vector<std::string> stages = {"odt","perturb","exude"},
+                                                                double time_budget = 0,
+                                                                double min_dihedral_angle = 0,
+                                                                double min_radius_ratio = 0);
 
         void protect_borders();
 
+        /**
+         * @brief Marks the segment index of the borders and features as outdated, 
+         * such that it is rebuilt on the next conflict check. Called by all functions
+         * that remove or replace borders and features.
+         * @param none
+         * @return void
+         */
+        void invalidate_edge_index() { edge_index_valid = false; }
+
         bool assert_non_empty_mesh_object();
        
     
@@ -512,10 +1063,8 @@ class Domain {
         std::pair<double,double > dihedral_angles_min_max()
         { 
           auto values = dihedral_angles();     
-          
-          double min = *std::min_element(values.begin(),values.end());
-          double max = *std::max_element(values.begin(),values.end());    
-          return std::make_pair(min,max);
+          auto minmax = std::minmax_element(values.begin(),values.end());
+          return std::make_pair(*minmax.first,*minmax.second);
         }
                 
         /**
@@ -529,75 +1078,260 @@ class Domain {
         std::pair<double,double > radius_ratio_min_max()
         { 
           auto values = radius_ratio();          
-          double min = *std::min_element(values.begin(),values.end());
-          double max = *std::max_element(values.begin(),values.end());    
-          return std::make_pair(min,max);
-          
+          auto minmax = std::minmax_element(values.begin(),values.end());
+          return std::make_pair(*minmax.first,*minmax.second);
         }
-        int remove_isolated_vertices(bool remove_domain=false);
+
+        std::shared_ptr<Quality_report> quality_report(int number_of_bins=10, 
+                                                       std::vector<double> percentiles={1,5,25,50,75,95,99}, 
+                                                       int number_of_worst_cells=10);
+        int remove_isolated_vertices();
+        Parameters get_isolated_vertices_report();
 
     private :
+        template<typename Function>
+        void run_with_threads(Function function);
+
+        void update_sizing_report_(double cell_size);
+
+        std::pair<double,double> minimum_quality_();
+
+        template<typename Surface>
+        void add_surface_(const Surface& surface);
+
+        void build_domain_(std::shared_ptr<AbstractMap> map, double error);
+
+        void refine_(const Mesh_criteria& criteria);
+
+        Mesh_criteria make_criteria_(double edge_size, double cell_size, double facet_size, 
+                                     double facet_angle, double facet_distance, double cell_radius_edge_ratio);
+
+        void update_edge_index_();
+
+        template<typename Surface>
+        std::vector<std::pair<int,int>> facet_segmentation_(const std::vector<Facet>& facets, double angle_in_degree);
+
+        int retag_facets_(const std::vector<Facet>& facets, const std::vector<std::pair<int,int>>& tags, int offset, bool only_exterior);
+
+        /**
+         * @brief Returns the handles of the cells in the complex, for parallel loops.
+         * @param none
+         * @return vector of cell handles in the order of the cells in complex iterator.
+         */
+        std::vector<Cell_handle> get_cells_in_complex()
+        {
+           std::vector<Cell_handle> cells;
+           cells.reserve(c3t3.number_of_cells_in_complex());
+           for ( Cell_iterator cit = c3t3.cells_in_complex_begin(); cit != c3t3.cells_in_complex_end(); ++cit )
+              cells.push_back(cit);
+           return cells;
+        }
+
         Function_vector v; 
+        std::vector<std::shared_ptr<Surface_mesh>> meshes;
         std::shared_ptr<AbstractMap> map_ptr;
         std::unique_ptr<Mesh_domain> domain_ptr;
         Minimum_sphere<Kernel> min_sphere; 
+        CGAL::Bbox_3 bounding_box;
+        std::shared_ptr<Labeling_oracle_statistics> oracle_statistics = std::make_shared<Labeling_oracle_statistics>();
+        std::shared_ptr<Mesh_sizes> sizes = std::make_shared<Mesh_sizes>();
+        Parameters sizing_report;
         C3t3 c3t3;
         Polylines borders; 
         Polylines features;
+        int num_threads = 1;
+        Complex_index complex_index;
+        bool complex_index_valid = false;
+        int removed_isolated_vertices = 0;
+        double isolated_vertices_removal_time = 0.0;
+        Segments edge_segments;
+        Segment_tree edge_tree;
+        std::set<std::pair<Point_3,Point_3>> edge_endpoints;
+        std::size_t indexed_borders = 0;
+        std::size_t indexed_features = 0;
+        bool edge_index_valid = false;
+#ifdef CGAL_LINKED_WITH_TBB
+        std::unique_ptr<Tr::Lock_data_structure> lock_ds_ptr;
+#endif
 };
 
-
 /**
- * @brief Removes vertices that is not connected to any cells in the mesh.
+ * @brief Sets the number of threads used by create_mesh and the optimization functions.
  *
- * A feature in CGAL is that not all vetices in triangulation is part 
- * of the mesh complex. 
+ * Parallel meshing requires that SVMTK is compiled with TBB, i.e. CGAL_LINKED_WITH_TBB 
+ * is defined. Otherwise, the meshing is sequential regardless of the number of threads. 
  *
- * @param c3t3 the mesh structure stored in the Domain class Obejct
- * @param remove_domain indication if a subdomain is removed, avoiding warning. 
- * @return integer number of vertices removed.
+ * @param number_of_threads the number of threads, where 0 means all available cores.
+ * @return void
+ * @throws InvalidArgumentError if number_of_threads is negative.
  */
+inline void Domain::set_number_of_threads(int number_of_threads)
+{
+   if (number_of_threads < 0)
+      throw InvalidArgumentError("Number of threads must be non-negative.");
+#ifndef CGAL_LINKED_WITH_TBB
+   if (number_of_threads != 1)
+      std::cout << "Warning, SVMTK is compiled without TBB, meshing will be sequential." << std::endl;
+#endif
+   num_threads = number_of_threads;
+}
 
-inline int Domain::remove_isolated_vertices(bool remove_domain)
-{ 
+/**
+ * @brief Enables or disables the counting and timing of the subdomain labeling oracle.
+ * 
+ * The labeling oracle is called by CGAL Mesh_3 for every point that is tested 
+ * during create_mesh. The counters are reset when this function is called. 
+ *
+ * @param enable true to collect statistics.
+ * @return void
+ */
+inline void Domain::enable_oracle_statistics(bool enable)
+{
+   oracle_statistics->reset();
+   oracle_statistics->enabled = enable;
+}
 
-  std::map<Vertex_handle, bool> vertex_map;
+/**
+ * @brief Returns the statistics of the subdomain labeling oracle.
+ * @see Domain::enable_oracle_statistics
+ * @param none
+ * @return map with the number of calls, ray casts, bounding box rejections, 
+ *         the total time in seconds and the time per call in nanoseconds.
+ */
+inline Domain::Parameters Domain::get_oracle_statistics()
+{
+   Parameters result;
+   double calls = static_cast<double>(oracle_statistics->calls.load());
+   double nanoseconds = static_cast<double>(oracle_statistics->nanoseconds.load());
+   result["calls"] = calls;
+   result["ray_casts"] = static_cast<double>(oracle_statistics->ray_casts.load());
+   result["bbox_rejections"] = static_cast<double>(oracle_statistics->bbox_rejections.load());
+   result["seconds"] = nanoseconds*1.e-9;
+   result["nanoseconds_per_call"] = calls > 0 ? nanoseconds/calls : 0.0;
+   return result;
+}
 
-  for( Finite_vertices_iterator vit = c3t3.triangulation().finite_vertices_begin();vit != c3t3.triangulation().finite_vertices_end();++vit)
-  { 
-        vertex_map[vit] = false ;  
-  }
+/**
+ * @brief Runs a meshing function on the stored mesh with the selected number of threads.
+ *
+ * With parallel meshing, the triangulation is given a lock data structure 
+ * that is sized from the bounding box of the domain. The lock data structure 
+ * is removed from the triangulation after the function call, also if it throws, 
+ * such that later sequential changes of the triangulation are not locked.
+ *
+ * @param function a callable without arguments that operates on c3t3.
+ * @return void
+ */
+template<typename Function>
+void Domain::run_with_threads(Function function)
+{
+   invalidate_complex_index();
+#ifdef CGAL_LINKED_WITH_TBB
+   if (!lock_ds_ptr)
+      lock_ds_ptr.reset(new Tr::Lock_data_structure(bounding_box, 
+                        CGAL::Mesh_3::Concurrent_mesher_config::get().locking_grid_num_cells_per_axis));
+
+   c3t3.triangulation().set_lock_data_structure(lock_ds_ptr.get());
+   try
+   {
+      run_with_number_of_threads(num_threads, function);
+   }
+   catch (...)
+   {
+      c3t3.triangulation().set_lock_data_structure(nullptr);
+      throw;
+   }
+   c3t3.triangulation().set_lock_data_structure(nullptr);
+#else
+   function();
+#endif
+}
 
-  for(Cell_iterator cit = c3t3.cells_in_complex_begin();cit != c3t3.cells_in_complex_end(); ++cit)
-  {
-    for (std::size_t i = 0; i < 4; ++i) // 
-    {
-        vertex_map[cit->vertex(i)] = true;
-    }
-  }
 
-  int before = c3t3.triangulation().number_of_vertices() ;
+/**
+ * @brief Removes vertices that is not connected to any cells in the mesh.
+ *
+ * A feature in CGAL is that not all vetices in triangulation is part 
+ * of the mesh complex. These vertices are skipped when the mesh is exported, 
+ * such that removal is only needed if the triangulation itself is used.
+ * The vertices are flagged in one pass over the cells in the complex, and 
+ * the number of removed vertices and the time is stored for 
+ * get_isolated_vertices_report.
+ * Removing a vertex retriangulates its star, so the complex is rescanned 
+ * and the facets between subdomains are bound again afterwards.
+ *
+ * @param none 
+ * @return integer number of vertices removed.
+ */
+inline int Domain::remove_isolated_vertices()
+{ 
+  auto start = std::chrono::steady_clock::now();
+  invalidate_complex_index();
+  Tr& tr = c3t3.triangulation();
 
-  for (typename std::map<Vertex_handle, bool>::const_iterator it = vertex_map.begin();it != vertex_map.end(); ++it)   {
-    if (!it->second) 
-    {
-       c3t3.triangulation().remove(it->first);
-    }
-  }
+  std::size_t number_of_connected;
+  std::vector<char> connected = connected_vertex_flags_(c3t3, number_of_connected);
 
-  int after = c3t3.triangulation().number_of_vertices() ; 
+  std::vector<Vertex_handle> isolated;
+  isolated.reserve(tr.number_of_vertices() - number_of_connected);
+  for( Finite_vertices_iterator vit = tr.finite_vertices_begin();vit != tr.finite_vertices_end();++vit)
+  { 
+        if ( !connected[vit->time_stamp()] )
+           isolated.push_back(vit);
+  }
 
-  std::cout<<"Number of isolated vertices removed: "<< before - after << std::endl;
-  double vertices_removed_ratio = 1.0 - (double)after/(double)before ;
-  
-  if (vertices_removed_ratio > 0.01 and !remove_domain)   
+  int before = tr.number_of_vertices() ;
+  tr.remove(isolated.begin(), isolated.end());
+  int after = tr.number_of_vertices() ; 
+  if ( before != after )
   {
-       std::cout<<"There were a significant number of isolated vertices, and the user should inspect the mesh."<< std::endl;  
-       std::cout<<"Methods to decrease number of isolated vertices : \n \t 1.isotropic remeshing \n \t 2.increase the mesh resolution or \n \t 3. specific mesh parameters to decrease number of isolated vertices."<< std::endl;  
+     c3t3.rescan_after_load_of_triangulation();
+     rebind_missing_facets();
   }
+
+  removed_isolated_vertices = before - after;
+  isolated_vertices_removal_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
   return (before - after);
 }
 
+/**
+ * @brief Returns the number of isolated vertices, i.e. vertices in the 
+ * triangulation that are not part of any cell in the mesh complex, without 
+ * changing the triangulation.
+ *
+ * The report contains:
+ * - triangulation_vertices, the number of finite vertices in the triangulation,
+ * - complex_vertices, the number of vertices of cells in the complex,
+ * - isolated_vertices and isolated_ratio,
+ * - flag_time, the time in seconds to flag the vertices,
+ * - removed_vertices and removal_time from the last call to remove_isolated_vertices.
+ *
+ * A large isolated_ratio indicates that the mesh should be inspected, and can 
+ * be decreased by isotropic remeshing, a higher mesh resolution or specific 
+ * mesh parameters.
+ * @param none
+ * @return report map from name to value.
+ */
+inline Domain::Parameters Domain::get_isolated_vertices_report()
+{
+  auto start = std::chrono::steady_clock::now();
+  std::size_t number_of_connected;
+  connected_vertex_flags_(c3t3, number_of_connected);
+  double flag_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  const double total = static_cast<double>(c3t3.triangulation().number_of_vertices());
+  const double isolated = total - static_cast<double>(number_of_connected);
+  Parameters report;
+  report["triangulation_vertices"] = total;
+  report["complex_vertices"] = static_cast<double>(number_of_connected);
+  report["isolated_vertices"] = isolated;
+  report["isolated_ratio"] = total > 0 ? isolated/total : 0.0;
+  report["flag_time"] = flag_time;
+  report["removed_vertices"] = static_cast<double>(removed_isolated_vertices);
+  report["removal_time"] = isolated_vertices_removal_time;
+  return report;
+}
+
 
 /**
  * @brief Computes the dihedral angle for all tetrahedron cells in complex (c3t3).
@@ -608,12 +1342,15 @@ inline std::vector<double> Domain::dihedral_angles()
 {
   assert_non_empty_mesh_object();
   const Tr& tr = c3t3.triangulation();
-  std::vector<double> result;
-  for(C3t3::Cells_in_complex_iterator cit = c3t3.cells_in_complex_begin();cit != c3t3.cells_in_complex_end(); ++cit)
+  std::vector<Cell_handle> cells = get_cells_in_complex();
+  std::vector<double> result(cells.size());
+  run_with_number_of_threads(num_threads, [&]()
   {
-      result.push_back(static_cast<double>(CGAL::Mesh_3::minimum_dihedral_angle(tr.tetrahedron(cit),Kernel())));
-
-  }
+     parallel_for_each_index(cells.size(), [&](std::size_t i)
+     {
+         result[i] = static_cast<double>(CGAL::Mesh_3::minimum_dihedral_angle(tr.tetrahedron(cells[i]),Kernel()));
+     });
+  });
   return result;
 }
 
@@ -626,14 +1363,55 @@ inline std::vector<double> Domain::radius_ratio()
 {
   assert_non_empty_mesh_object();
   const Tr& tr = c3t3.triangulation();
-  std::vector<double> result;
-  for(C3t3::Cells_in_complex_iterator cit = c3t3.cells_in_complex_begin();cit != c3t3.cells_in_complex_end(); ++cit)
+  std::vector<Cell_handle> cells = get_cells_in_complex();
+  std::vector<double> result(cells.size());
+  run_with_number_of_threads(num_threads, [&]()
   {
-     result.push_back(static_cast<double>(CGAL::Mesh_3::radius_ratio(tr.tetrahedron(cit),Kernel() )));
-  }
+     parallel_for_each_index(cells.size(), [&](std::size_t i)
+     {
+         result[i] = static_cast<double>(CGAL::Mesh_3::radius_ratio(tr.tetrahedron(cells[i]),Kernel() ));
+     });
+  });
   return result;
 }
 
+/**
+ * @brief Computes the minimum and maximum dihedral angle, radius ratio, edge ratio, 
+ * volume and aspect ratio of all cells in complex (c3t3) in one parallel pass, 
+ * with histograms and percentiles for each subdomain and the worst cells of each metric.
+ *
+ * @param number_of_bins the number of bins in the histograms.
+ * @param percentiles the percentiles in [0,100] to compute for each subdomain. 
+ * @param number_of_worst_cells the number of worst cells to report for each metric.
+ * @return report the quality report, @see Quality_report.
+ */
+inline std::shared_ptr<Quality_report> Domain::quality_report(int number_of_bins, std::vector<double> percentiles, int number_of_worst_cells)
+{
+  assert_non_empty_mesh_object();
+  if ( number_of_worst_cells < 0 )
+     throw InvalidArgumentError("Number of worst cells must be non-negative.");
+
+  const Tr& tr = c3t3.triangulation();
+  std::vector<Cell_handle> cells = get_cells_in_complex();
+  auto report = std::make_shared<Quality_report>();
+  report->resize(cells.size());
+  run_with_number_of_threads(num_threads, [&]()
+  {
+     parallel_for_each_index(cells.size(), [&](std::size_t i)
+     {
+        std::array<std::array<double,3>,4> points;
+        for ( int j = 0; j < 4; ++j )
+        {
+           const Weighted_point& p = tr.point(cells[i], j);
+           points[j] = {CGAL::to_double(p.x()), CGAL::to_double(p.y()), CGAL::to_double(p.z())};
+        }
+        report->set(i, static_cast<int>(c3t3.subdomain_index(cells[i])), tetrahedron_quality(points));
+     });
+     report->compute_statistics(number_of_bins, percentiles, static_cast<std::size_t>(number_of_worst_cells));
+  });
+  return report;
+}
+
 
 /**
  * @brief Rebinds missing facets. 
@@ -648,6 +1426,7 @@ inline std::vector<double> Domain::radius_ratio()
  */
 inline void Domain::rebind_missing_facets()
 {
+  invalidate_complex_index();
   for(C3t3::Cells_in_complex_iterator cit = c3t3.cells_in_complex_begin();cit != c3t3.cells_in_complex_end(); ++cit)
   {
       Cell_handle cn = cit;
@@ -683,7 +1462,8 @@ inline void Domain::rebind_missing_facets()
  */
 inline bool Domain::assert_non_empty_mesh_object()
 {
-     if ((number_of_cells()+number_of_facets()+number_of_vertices())==0)
+     // Counted directly on c3t3, since number_of_vertices builds the complex index.
+     if ((c3t3.number_of_cells_in_complex()+c3t3.number_of_facets_in_complex()+c3t3.triangulation().number_of_vertices())==0)
      {  throw  EmptyMeshError("3D mesh object is empty.");
         return false;
      }
@@ -693,216 +1473,216 @@ inline bool Domain::assert_non_empty_mesh_object()
 
 
 /**
- * @brief Segments the boundary of a specified subdomain tag.
+ * @brief Segments a set of mesh facets with Surface::face_segmentation.
+ *
+ * The surface mesh is built face by face in the order of the facets, and each 
+ * face stores the index of its facet, such that the segmentation tags are mapped 
+ * back to the facets without point location. A facet that can not be added to the 
+ * connected surface mesh, i.e. at a non-manifold edge or vertex, is added with 
+ * its own vertices.
+ *
+ * @tparam SVMTK Surface object 
+ * @param facets the facets to segment, oriented consistently.
+ * @param angle_in_degree the threshold angle used to detect sharp edges.
+ * @return tags the segmentation tag of each facet, starting at 1. 
+ */
+template <typename Surface>
+inline std::vector<std::pair<int,int>> Domain::facet_segmentation_(const std::vector<Facet>& facets, double angle_in_degree)
+{
+  static_assert(std::is_same<typename Surface::Mesh, Surface_mesh>::value, "Surface::Mesh must be Domain::Surface_mesh.");
+  typedef Surface_mesh::Vertex_index Vertex_index;
+  typedef Surface_mesh::Face_index   Face_index;
+
+  std::vector<Point_3> points;
+  std::vector<Face> faces;
+  facets_to_triangle_soup_(c3t3, facets, points, faces);
+
+  Surface surf;
+  Surface_mesh& mesh = surf.get_mesh();
+  mesh.reserve(points.size(), 3*faces.size()/2, faces.size());
+  std::vector<Vertex_index> vertices;
+  vertices.reserve(points.size());
+  for ( auto& point : points )
+     vertices.push_back(mesh.add_vertex(point));
+
+  Surface_mesh::Property_map<Face_index,std::size_t> facet_index = mesh.add_property_map<Face_index,std::size_t>("f:facet").first;
+  for ( std::size_t i = 0; i < faces.size(); ++i ) 
+  {
+     Face_index f = mesh.add_face(vertices[faces[i][0]], vertices[faces[i][1]], vertices[faces[i][2]]);
+     if ( f == Surface_mesh::null_face() )
+        f = mesh.add_face(mesh.add_vertex(points[faces[i][0]]), mesh.add_vertex(points[faces[i][1]]), mesh.add_vertex(points[faces[i][2]]));
+     facet_index[f] = i;
+  }
+  for ( Vertex_index v : vertices )
+  {
+     if ( mesh.is_isolated(v) )
+        mesh.remove_vertex(v);
+  }
+  mesh.collect_garbage();
+
+  std::vector<std::pair<int,int>> segmentation = surf.face_segmentation(1, angle_in_degree);
+  std::vector<std::pair<int,int>> tags(facets.size());
+  std::size_t k = 0;
+  for ( Face_index f : mesh.faces() )
+     tags[facet_index[f]] = segmentation[k++];
+  return tags;
+}
+
+/**
+ * @brief Sets the surface patch index of the facets to the segmentation tags.
+ *
+ * @param facets the segmented facets.
+ * @param tags the segmentation tag of each facet.
+ * @param offset added to the first value of each tag.
+ * @param only_exterior if true, only facets on the boundary of the mesh are updated.
+ * @return the largest surface patch tag set, or offset if no facets are updated. 
+ */
+inline int Domain::retag_facets_(const std::vector<Facet>& facets, const std::vector<std::pair<int,int>>& tags, int offset, bool only_exterior)
+{
+  int max_tag = offset;
+  for ( std::size_t i = 0; i < facets.size(); ++i ) 
+  {
+     Cell_handle ch = facets[i].first;
+     int n = facets[i].second;
+     if ( only_exterior and c3t3.subdomain_index(ch) != 0 and c3t3.subdomain_index(ch->neighbor(n)) != 0 )
+        continue;
+     c3t3.remove_from_complex(ch,n);
+     c3t3.add_to_complex(ch, n, Surface_patch_index(tags[i].first + offset, tags[i].second) ); 
+     max_tag = std::max(max_tag, tags[i].first + offset);
+  }
+  return max_tag;
+}
+
+/**
+ * @brief Returns the boundary facets of each subdomain, in one pass over the 
+ * cells in the complex. 
+ *
+ * A facet between two subdomains is in the boundary of both, and is stored 
+ * once for each subdomain by the cell in that subdomain.
+ * @param none
+ * @return map from subdomain tag to boundary facets.
+ */
+inline std::map<int,std::vector<Facet>> Domain::get_subdomain_boundary_facets()
+{
+  std::map<int,std::vector<Facet>> boundary_facets;
+  for(Cell_iterator cit = c3t3.cells_in_complex_begin();cit != c3t3.cells_in_complex_end(); ++cit)
+  {
+     Subdomain_index ci = c3t3.subdomain_index(cit);
+     for( int i =0 ; i<4 ; ++i)
+     {
+        if ( c3t3.subdomain_index(cit->neighbor(i)) != ci and c3t3.is_in_complex(cit,i) )
+           boundary_facets[static_cast<int>(ci)].push_back(Facet(cit,i));
+     }
+  }
+  return boundary_facets;
+}
+
+/**
+ * @brief Segments the interface between two subdomains.
  * 
- * Calls Surface::surface_segmentation on the boundary surfaces specifiec by input, and 
- * updates the boundary facets with the segementation tags. 
+ * Calls Surface::face_segmentation on the facets of the interface, and 
+ * updates the facets with the segementation tags. 
+ *
+ * @note The interface is segmented as it is, and is no longer closed with 
+ * Surface::fill_holes first. The facets along the border of an open interface 
+ * may therefore be split into other patches than in earlier versions.
  * 
  * @tparam SVMTK Surface object 
- * @param subdmain_tag used to obtain the boundary of subdomain with tag.
+ * @param interface the surface patch tag of the interface.
  * @param angle_in_degree the threshold angle used to detect sharp edges.
  * @return none, updates surface_patches of mesh.  
- * FIXME
  */
- 
 template <typename Surface>
 inline void Domain::boundary_segmentations(std::pair<int,int> interface, double angle_in_degree)
 {
-
   assert_non_empty_mesh_object();
-  
-  const Tr& tr = c3t3.triangulation();
-  
-  auto patches = get_patches();
-
-  auto p = std::minmax_element(patches.begin(),patches.end()); //subdomain+1?
 
-  int tag_ = 1+p.second->first;
+  if (interface.first == interface.second)
+      throw InvalidArgumentError("There are no interfaces between similar tags.") ;
 
-  std::shared_ptr<Surface> surf;
-  
-  
-  surf =  get_interface<Surface>(interface); 
-  
-  
-    
-    
-  surf.get()->set_outward_face_orientation();
-  surf.get()->save("jfam.off");
-  surf.get()->fill_holes();
-  surf.get()->save("jfam2.off");
-  auto T2tagmap =surf.get()->surface_segmentation(tag_,angle_in_degree); // error
-
-  int i,j,k,n;
-  
-  Cell_handle ch,cn; 
-  Vertex_handle vh1,vh2,vh3;
-  
-  std::map<int,int> temp;
-  
-  for ( auto pit : T2tagmap) 
-  {  
-     Weighted_point wp1(pit.first[1]); 
-     Weighted_point wp2(pit.first[2]); 
-     Weighted_point wp3(pit.first[3]); 
- 
-     tr.is_vertex(wp1,vh1);
-     tr.is_vertex(wp2,vh2);
-     tr.is_vertex(wp3,vh3);    
-               
-     if ( tr.is_facet(vh1,vh2,vh3,ch,i,j,k) ) 
-     {      
-     n = (6- (i+j+k) ); // 3+2+1 -> 0 , 3+1+0 -> 2 etc.
-     
-     cn = ch->neighbor(n);
-     
-     //Subdomain_index ci = static_cast<int>(c3t3.subdomain_index(ch));     
-     //Subdomain_index cj = static_cast<int>(c3t3.subdomain_index(cn)); 
-     
-     //if (!c3t3.is_in_complex(ch,n))
-     //   continue;
-     
-
-     //if ( ( ci!=interface.first and cj!=interface.second ) or (cj!=interface.first and ci!=interface.second ) )
-     //   continue;
-     
-     
-
-     c3t3.remove_from_complex(ch,n);
-     c3t3.add_to_complex(ch, n, Surface_patch_index(pit.second.first,pit.second.second) ); 
-     }
-     /*if( ci!=cj )
-     {   
-        if ( cj==0 ) 
-        {
-          
-           c3t3.remove_from_complex(ch,n); 
-           c3t3.add_to_complex(ch, n, Surface_patch_index(pit.second.first,pit.second.second)  ); 
-      
-        }   
-        else if ( ci==0)
-        {
-           
-           c3t3.remove_from_complex(ch,n);template<typename Surface>
-           c3t3.add_to_complex(ch, n, Surface_patch_index(pit.second.first,pit.second.second) ); 
-
-        }
-        
-    }*/
-     
- 
+  auto patches = get_patches();
+  int offset = patches.empty() ? 0 : std::max_element(patches.begin(),patches.end())->first; 
+
+  const Complex_index& index = get_complex_index();
+  auto facets_it = index.patch_facets.find(interface);
+  if ( facets_it == index.patch_facets.end() )
+     return;
+  std::vector<Facet> facets = facets_it->second;
+  // Orient all facets from the side of interface.first
+  for ( Facet& facet : facets )
+  {
+     if ( c3t3.subdomain_index(facet.first) != interface.first )
+        facet = c3t3.triangulation().mirror_facet(facet);
   }
 
-
-  return;
+  std::vector<std::pair<int,int>> tags; 
+  run_with_number_of_threads(num_threads, [&](){ tags = facet_segmentation_<Surface>(facets, angle_in_degree); });
+  retag_facets_(facets, tags, offset, false);
+  invalidate_complex_index();
 }
 
-
-
 /**
  * @brief Segments the boundary of a specified subdomain tag.
  * 
- * Calls Surface::surface_segmentation on the boundary surfaces specifiec by input, and 
- * updates the boundary facets with the segementation tags. 
+ * Calls Surface::face_segmentation on the boundary facets of the subdomain, and 
+ * updates the facets on the boundary of the mesh with the segementation tags. 
  * 
  * @tparam SVMTK Surface object 
  * @param subdmain_tag used to obtain the boundary of subdomain with tag.
  * @param angle_in_degree the threshold angle used to detect sharp edges.
  * @return none, updates surface_patches of mesh.  
- * 
  */
 template <typename Surface>
 inline void Domain::boundary_segmentations(int subdomain_tag, double angle_in_degree)
 {
-
   assert_non_empty_mesh_object();
   
-  const Tr& tr = c3t3.triangulation();
-  
   auto patches = get_patches();
+  int offset = patches.empty() ? 0 : std::max_element(patches.begin(),patches.end())->first; 
 
+  std::vector<Facet> facets = get_subdomain_boundary_facets()[subdomain_tag];
 
-  auto p = std::minmax_element(patches.begin(),patches.end()); 
-
-  int tag_ = 1+p.second->first;
-  
-  std::shared_ptr<Surface> surf;
-  
-  surf =  get_boundary<Surface>(subdomain_tag);
- 
-  
-  auto T2tagmap =surf.get()->surface_segmentation(tag_,angle_in_degree); // error
-
-  int i,j,k,n;
-  
-  Cell_handle ch,cn; 
-  Vertex_handle vh1,vh2,vh3;
-  
-  for ( auto pit : T2tagmap) 
-  {  
-     Weighted_point wp1(pit.first[1]); 
-     Weighted_point wp2(pit.first[2]); 
-     Weighted_point wp3(pit.first[3]); 
- 
-     tr.is_vertex(wp1,vh1);
-     tr.is_vertex(wp2,vh2);
-     tr.is_vertex(wp3,vh3);    
-               
-     tr.is_facet(vh1,vh2,vh3,ch,i,j,k);
-          
-     n = (6- (i+j+k) ); // 3+2+1 -> 0 , 3+1+0 -> 2 etc.
-     
-     cn = ch->neighbor(n);
-     Subdomain_index ci = static_cast<int>(c3t3.subdomain_index(ch));     
-     Subdomain_index cj = static_cast<int>(c3t3.subdomain_index(cn)); 
-
-
-     if( ci!=cj )
-     {   
-        if ( cj==0 ) 
-        {           
-           c3t3.remove_from_complex(ch,n); 
-           c3t3.add_to_complex(ch, n, Surface_patch_index(pit.second.first,pit.second.second)  ); 
-           
-        }   
-        else if ( ci==0)
-        {
-           c3t3.remove_from_complex(ch,n);
-           c3t3.add_to_complex(ch, n, Surface_patch_index(pit.second.first,pit.second.second) ); 
-
-        }
-        
-    } 
-     
- 
-  }
-
-
-  return;
+  std::vector<std::pair<int,int>> tags; 
+  run_with_number_of_threads(num_threads, [&](){ tags = facet_segmentation_<Surface>(facets, angle_in_degree); });
+  retag_facets_(facets, tags, offset, true);
+  invalidate_complex_index();
 }
 
-
 /**
  * @brief Segments the boundary of the stored mesh.
  * 
- * Calls Surface::surface_segmentation on the boundary surfaces specifiec by input, and 
- * updates the boundary facets  with the segementation tags 
+ * The boundary of each subdomain is segmented in parallel, if SVMTK is built with TBB. 
+ * The segmentation tags are then shifted in order of the subdomain tags, such that 
+ * each new surface patch has a unique tag.
  * 
  * @tparam SVMTK Surface object 
  * @param angle_in_degree the threshold angle used to detect sharp edges.
  * @return none, updates surface_patches of mesh.  
- * 
  */
 template <typename Surface>
 inline void Domain::boundary_segmentations(double angle_in_degree)
 {
+  assert_non_empty_mesh_object();
 
-  auto tags = get_subdomains();
-  for ( auto tag : tags ) 
+  auto patches = get_patches();
+  int offset = patches.empty() ? 0 : std::max_element(patches.begin(),patches.end())->first; 
+
+  std::vector<std::vector<Facet>> facets;
+  for ( auto& it : get_subdomain_boundary_facets() )
+     facets.push_back(std::move(it.second));
+
+  std::vector<std::vector<std::pair<int,int>>> tags(facets.size()); 
+  run_with_number_of_threads(num_threads, [&]()
   {
-     boundary_segmentations<Surface>(tag,angle_in_degree);
-  }
-  
+     parallel_for_each_index(facets.size(), [&](std::size_t i)
+     {
+        tags[i] = facet_segmentation_<Surface>(facets[i], angle_in_degree);
+     });
+  });
+
+  for ( std::size_t i = 0; i < facets.size(); ++i )
+     offset = retag_facets_(facets[i], tags[i], offset, true);
+  invalidate_complex_index();
 }
 
 
@@ -944,93 +1724,179 @@ inline void Domain::set_features()
  */
 inline std::set<int> Domain::get_curves()
 {
-    const Tr& tr = c3t3.triangulation();
+    const Complex_index& index = get_complex_index();
     std::set<int> result;
-    for( auto eit = tr.finite_edges_begin(); eit != tr.finite_edges_end(); ++eit) 
-    {   
-         result.insert(static_cast<int>(c3t3.curve_index(*eit))); 
-    } 
+    for ( auto& it : index.curve_edges )
+        result.insert(it.first);
+    if ( index.has_non_curve_edges )
+        result.insert(static_cast<int>(Curve_index()));
     return result;       
 }
 
 /**
- * 
- * @param surface a vector of SVMTK class Surface objects defined in Surface.h 
+ * @brief Returns the index of the mesh complex by subdomain, surface patch and curve tags.
+ *
+ * The index is built in one pass over the cells and edges in the complex, and 
+ * is reused until the mesh complex is changed.
+ * @param none 
+ * @return complex_index the cached index.
  */
-template<typename Surface>
-Domain::Domain( std::vector<Surface> surfaces ,double error)
+inline const Domain::Complex_index& Domain::get_complex_index()
 {
-    for(typename std::vector<Surface>::iterator sit= surfaces.begin() ;sit!= surfaces.end();sit++)
+    if ( complex_index_valid )
+       return complex_index;
+
+    Complex_index index;
+    for(Cell_iterator cit = c3t3.cells_in_complex_begin();cit != c3t3.cells_in_complex_end(); ++cit)
     {
-       if (!sit->does_bound_a_volume())
-          sit->fill_holes();
-       
-       
-       Polyhedron polyhedron;
-       sit->get_polyhedron(polyhedron);
-       min_sphere.add_polyhedron(polyhedron);
-       Polyhedral_mesh_domain_3 *polyhedral_domain = new Polyhedral_mesh_domain_3(polyhedron);
-       this->v.push_back(polyhedral_domain);
+       index.subdomain_cells[static_cast<int>(c3t3.subdomain_index(cit))]++;
+       for( int i =0 ; i<4 ; ++i)
+       {
+          Surface_patch_index spi = c3t3.surface_patch_index(cit,i);
+          if ( spi.first == spi.second )
+             continue;
+          Cell_handle cn = cit->neighbor(i);
+          if ( c3t3.is_in_complex(cn) and cn < Cell_handle(cit) )
+             continue; 
+          index.patch_facets[std::pair<int,int>(static_cast<int>(spi.first), static_cast<int>(spi.second))].push_back(Facet(cit,i));
+       }
+    }
+    std::size_t number_of_curve_edges = 0;
+    for( auto eit = c3t3.edges_in_complex_begin(); eit != c3t3.edges_in_complex_end(); ++eit) 
+    {
+       index.curve_edges[static_cast<int>(c3t3.curve_index(*eit))].push_back(*eit);
+       number_of_curve_edges++;
     }
-    map_ptr = std::shared_ptr<DefaultMap>( new  DefaultMap()) ; 
+    index.has_non_curve_edges = c3t3.triangulation().number_of_finite_edges() > number_of_curve_edges;
+    connected_vertex_flags_(c3t3, index.number_of_vertices);
 
-    Function_wrapper wrapper(this->v, map_ptr);
+    complex_index = std::move(index);
+    complex_index_valid = true;
+    return complex_index;
+}
 
-    domain_ptr=std::unique_ptr<Mesh_domain>( new Mesh_domain(
-               Labeled_Mesh_Domain(wrapper,wrapper.bbox(),FT(error) ))); 
+/**
+ * @brief Returns the number of cells for each subdomain tag.
+ * @param none 
+ * @return map from subdomain tag to the number of cells.
+ */
+inline std::map<int,int> Domain::get_subdomain_cell_counts()
+{
+    std::map<int,int> result;
+    for ( auto& it : get_complex_index().subdomain_cells )
+        result[it.first] = static_cast<int>(it.second);
+    return result;
 }
 
 /**
+ * @brief Adds a surface to the domain. 
  *
- * @param surfaces a vector of SVMTK class Surface objects defined in local header Surface.h 
- * @param map a smart pointer to SVMTK virtuell class AbstractMap defind in local header SubdomainMap.h
+ * The surface mesh is copied once, such that later changes to the surface do not 
+ * affect the domain, and the polyhedral domain with its AABB tree is built directly 
+ * on the copy. Surfaces that do not bound a volume are copied and filled. 
+ *
+ * @param surface SVMTK class Surface object defined in local header Surface.h
+ * @return void
+ * @throws EmptyMeshError if the surface is empty.
  */
 template<typename Surface>
-Domain::Domain( std::vector<Surface> surfaces , std::shared_ptr<AbstractMap> map, double error )
+void Domain::add_surface_(const Surface& surface)
 {
- 
-    for(typename std::vector<Surface>::iterator sit= surfaces.begin() ;sit!= surfaces.end();sit++)
+    static_assert(std::is_same<typename Surface::Mesh, Surface_mesh>::value, "Surface::Mesh must be Domain::Surface_mesh.");
+    if ( surface.get_mesh().is_empty() )
+       throw EmptyMeshError("Surface is empty") ;
+
+    std::shared_ptr<Surface_mesh> mesh;
+    if ( CGAL::Polygon_mesh_processing::does_bound_a_volume(surface.get_mesh()) )
+       mesh = std::make_shared<Surface_mesh>(surface.get_mesh());
+    else
     {
-       if (!sit->does_bound_a_volume())
-          sit->fill_holes();
-        
-       
-       Polyhedron polyhedron; 
-       sit->get_polyhedron(polyhedron);
-       min_sphere.add_polyhedron(polyhedron);
-       Polyhedral_mesh_domain_3 *polyhedral_domain = new Polyhedral_mesh_domain_3(polyhedron);
-       this->v.push_back(polyhedral_domain);
+       Surface filled(surface);
+       filled.fill_holes();
+       mesh = std::make_shared<Surface_mesh>(std::move(filled.get_mesh()));
     }
+    min_sphere.add_mesh(*mesh);
+    this->v.push_back(new Polyhedral_mesh_domain_3(*mesh));
+    meshes.push_back(std::move(mesh));
+}
 
+/**
+ * @brief Builds the labeled mesh domain of the added surfaces. 
+ * @param map a smart pointer to SVMTK virtuell class AbstractMap defind in local header SubdomainMap.h
+ * @param error the relative error bound of the mesh domain.
+ * @return void
+ */
+inline void Domain::build_domain_(std::shared_ptr<AbstractMap> map, double error)
+{
+    min_sphere.compute();
     map_ptr = std::move(map);
-    Function_wrapper wrapper(this->v,map_ptr);
+
+    Function_wrapper wrapper(this->v, map_ptr, oracle_statistics);
+    bounding_box = wrapper.bbox();
 
     domain_ptr=std::unique_ptr<Mesh_domain> (new Mesh_domain( Labeled_Mesh_Domain(wrapper,wrapper.bbox(),FT(error) ))); 
 }
 
 /**
  *
- * @param surface SVMTK class Surface object defined in local header Surface.h
+ * @param surfaces a vector of SVMTK class Surface objects defined in local header Surface.h 
  */
 template<typename Surface>
-Domain::Domain(Surface &surface,double error) 
+Domain::Domain(const std::vector<Surface>& surfaces ,double error)
 {
-    if (!surface.does_bound_a_volume())
-        surface.fill_holes();
-       
-    Polyhedron polyhedron;
-    surface.get_polyhedron(polyhedron);
+    for ( const Surface& surface : surfaces )
+       add_surface_(surface);
+    build_domain_(std::make_shared<DefaultMap>(), error);
+}
 
-    min_sphere.add_polyhedron(polyhedron);
-    Polyhedral_mesh_domain_3 *polyhedral_domain = new Polyhedral_mesh_domain_3(polyhedron);
+/**
+ *
+ * @param surfaces a vector of SVMTK class Surface objects defined in local header Surface.h 
+ * @param map a smart pointer to SVMTK virtuell class AbstractMap defind in local header SubdomainMap.h
+ */
+template<typename Surface>
+Domain::Domain(const std::vector<Surface>& surfaces , std::shared_ptr<AbstractMap> map, double error )
+{
+    for ( const Surface& surface : surfaces )
+       add_surface_(surface);
+    build_domain_(std::move(map), error);
+}
 
-    this->v.push_back(polyhedral_domain);
-    map_ptr = std::shared_ptr<DefaultMap>( new  DefaultMap());
+/**
+ *
+ * @param surfaces a vector of smart pointers to SVMTK class Surface objects, used by the 
+ *        Python bindings to avoid copies of the surfaces. 
+ */
+template<typename Surface>
+Domain::Domain(const std::vector<std::shared_ptr<Surface>>& surfaces ,double error)
+{
+    for ( auto& surface : surfaces )
+       add_surface_(*surface);
+    build_domain_(std::make_shared<DefaultMap>(), error);
+}
 
-    Function_wrapper wrapper(this->v,map_ptr);
-    //
+/**
+ *
+ * @param surfaces a vector of smart pointers to SVMTK class Surface objects. 
+ * @param map a smart pointer to SVMTK virtuell class AbstractMap defind in local header SubdomainMap.h
+ */
+template<typename Surface>
+Domain::Domain(const std::vector<std::shared_ptr<Surface>>& surfaces , std::shared_ptr<AbstractMap> map, double error )
+{
+    for ( auto& surface : surfaces )
+       add_surface_(*surface);
+    build_domain_(std::move(map), error);
+}
 
-    domain_ptr=std::unique_ptr<Mesh_domain> (new Mesh_domain( Labeled_Mesh_Domain(wrapper,wrapper.bbox(),FT(error) ))); 
+/**
+ *
+ * @param surface SVMTK class Surface object defined in local header Surface.h
+ */
+template<typename Surface>
+Domain::Domain(const Surface &surface,double error) 
+{
+    add_surface_(surface);
+    build_domain_(std::make_shared<DefaultMap>(), error);
 }
 
 /** 
@@ -1049,24 +1915,24 @@ inline void Domain::create_mesh(double edge_size,double cell_size, double facet_
 {
     set_borders();
     set_features();
+    map_ptr->freeze(number_of_surfaces());
 
-    Mesh_criteria criteria(CGAL::parameters::edge_size = edge_size,
-                           CGAL::parameters::facet_angle=facet_angle ,
-                           CGAL::parameters::facet_size =facet_size,
-                           CGAL::parameters::facet_distance=facet_distance,
-                           CGAL::parameters::cell_radius_edge_ratio=cell_radius_edge_ratio,
-                           CGAL::parameters::cell_size=cell_size );
+    Mesh_criteria criteria = make_criteria_(edge_size, cell_size, facet_size, facet_angle, facet_distance, cell_radius_edge_ratio);
 
     std::cout << "Start meshing" << std::endl;
     
-    c3t3 = CGAL::make_mesh_3<C3t3>(*domain_ptr.get(), criteria,CGAL::parameters::no_exude(),  
-                                                               CGAL::parameters::no_perturb(),
-                                                               CGAL::parameters::features(),
-                                                               CGAL::parameters::non_manifold()); 
-    
-    remove_isolated_vertices();
+    run_with_threads([&]()
+    {
+       c3t3 = CGAL::make_mesh_3<C3t3>(*domain_ptr.get(), criteria,CGAL::parameters::no_exude(),  
+                                                                  CGAL::parameters::no_perturb(),
+                                                                  CGAL::parameters::features(),
+                                                                  CGAL::parameters::non_manifold()); 
+    });
+
+    invalidate_complex_index();
     c3t3.rescan_after_load_of_triangulation();
     rebind_missing_facets();        
+    update_sizing_report_(cell_size);
     std::cout << "Done meshing" << std::endl;
 }
 
@@ -1082,28 +1948,214 @@ inline void Domain::create_mesh(const double mesh_resolution )
 {
     set_borders();
     set_features();
+    map_ptr->freeze(number_of_surfaces());
 
     double r = min_sphere.get_bounding_sphere_radius(); 
     const double cell_size = r/mesh_resolution;
     std::cout << "Cell size: " << cell_size << std::endl;
 
-    Mesh_criteria criteria(CGAL::parameters::edge_size = cell_size,
-                                       CGAL::parameters::facet_angle = 30.0,
-                                       CGAL::parameters::facet_size = cell_size,
-                                       CGAL::parameters::facet_distance = cell_size/10.0, 
-                                       CGAL::parameters::cell_radius_edge_ratio = 3.0,
-                                       CGAL::parameters::cell_size = cell_size);
+    Mesh_criteria criteria = make_criteria_(cell_size, cell_size, cell_size, 30.0, cell_size/10.0, 3.0);
 
     std::cout << "Start meshing" << std::endl;
-    c3t3 = CGAL::make_mesh_3<C3t3>(*domain_ptr.get(), criteria,CGAL::parameters::no_exude());
-   
-    remove_isolated_vertices();
+    run_with_threads([&]()
+    {
+       c3t3 = CGAL::make_mesh_3<C3t3>(*domain_ptr.get(), criteria,CGAL::parameters::no_exude());
+    });
+
+    invalidate_complex_index();
     c3t3.rescan_after_load_of_triangulation();
     rebind_missing_facets();
+    update_sizing_report_(cell_size);
     std::cout << "Done meshing" << std::endl;
 
 }
 
+/**
+ * @brief Refines the stored mesh with tighter mesh criteria, continuing from the 
+ * current triangulation instead of creating the mesh from nothing.
+ * 
+ * The protected borders and features, i.e. the edges and corners in the complex, 
+ * are kept, while the cells and facets are recomputed from the mesh domain with the 
+ * new criteria. Borders and features added after create_mesh are not protected. 
+ * @note Surface patches set by boundary_segmentations and removed subdomains are 
+ * recomputed from the mesh domain.
+ * @param edge_size mesh criteria for the maximum edge size 
+ * @param cell_size mesh criteria for the maximum cell size  
+ * @param facet_size mesh criteria for the maximum facet size 
+ * @param facet_angle mesh criteria for the minimum edge size 
+ * @param facet_distance mesh criteria for surface approximation  
+ * @param cell_radius_edge_ratio mesh criteria for the relation between cell rddius and edge
+ * @see [CGAL::refine_mesh_3](https://doc.cgal.org/latest/Mesh_3/group__PkgMesh3Functions.html) 
+ * @throws EmptyMeshError if the mesh is not created.
+ * @overload
+ */
+inline void Domain::refine(double edge_size,double cell_size, double facet_size,double facet_angle,  double facet_distance,double cell_radius_edge_ratio)
+{
+    assert_non_empty_mesh_object();
+
+    Mesh_criteria criteria = make_criteria_(edge_size, cell_size, facet_size, facet_angle, facet_distance, cell_radius_edge_ratio);
+    refine_(criteria);
+    update_sizing_report_(cell_size);
+}
+
+/**
+ * @brief Refines the stored mesh with the mesh criteria of create_mesh for a 
+ * higher mesh resolution, continuing from the current triangulation.
+ * @param mesh_resolution a value determined 
+ * @throws EmptyMeshError if the mesh is not created.
+ * @overload
+ */
+inline void Domain::refine(const double mesh_resolution)
+{
+    assert_non_empty_mesh_object();
+
+    double r = min_sphere.get_bounding_sphere_radius(); 
+    const double cell_size = r/mesh_resolution;
+    std::cout << "Cell size: " << cell_size << std::endl;
+
+    Mesh_criteria criteria = make_criteria_(cell_size, cell_size, cell_size, 30.0, cell_size/10.0, 3.0);
+    refine_(criteria);
+    update_sizing_report_(cell_size);
+}
+
+/**
+ * @brief Returns the mesh criteria for create_mesh and refine.
+ *
+ * Without subdomain, interface or curve sizes, the criteria are constant, where a 
+ * size of 0 means no bound. Otherwise the sizes are given by Tag_sizing_field, with 
+ * the sizes as the default size for elements without a tag size.
+ * @param edge_size mesh criteria for the maximum edge size 
+ * @param cell_size mesh criteria for the maximum cell size  
+ * @param facet_size mesh criteria for the maximum facet size 
+ * @param facet_angle mesh criteria for the minimum edge size 
+ * @param facet_distance mesh criteria for surface approximation  
+ * @param cell_radius_edge_ratio mesh criteria for the relation between cell rddius and edge
+ * @return the mesh criteria.
+ */
+inline Domain::Mesh_criteria Domain::make_criteria_(double edge_size, double cell_size, double facet_size, 
+                                                    double facet_angle, double facet_distance, double cell_radius_edge_ratio)
+{
+    if ( sizes->empty() )
+       return Mesh_criteria(CGAL::parameters::edge_size = edge_size,
+                            CGAL::parameters::facet_angle=facet_angle ,
+                            CGAL::parameters::facet_size =facet_size,
+                            CGAL::parameters::facet_distance=facet_distance,
+                            CGAL::parameters::cell_radius_edge_ratio=cell_radius_edge_ratio,
+                            CGAL::parameters::cell_size=cell_size );
+
+    std::shared_ptr<const Mesh_sizes> mesh_sizes = std::make_shared<Mesh_sizes>(*sizes);
+    return Mesh_criteria(CGAL::parameters::edge_size = Tag_sizing_field<Mesh_domain>(*domain_ptr, mesh_sizes, edge_size),
+                         CGAL::parameters::facet_angle=facet_angle ,
+                         CGAL::parameters::facet_size = Tag_sizing_field<Mesh_domain>(*domain_ptr, mesh_sizes, facet_size),
+                         CGAL::parameters::facet_distance=facet_distance,
+                         CGAL::parameters::cell_radius_edge_ratio=cell_radius_edge_ratio,
+                         CGAL::parameters::cell_size = Tag_sizing_field<Mesh_domain>(*domain_ptr, mesh_sizes, cell_size) );
+}
+
+/**
+ * @brief Refines the stored mesh with refine_mesh_3, and restores the consistency 
+ * of the complex as in create_mesh.
+ * @param criteria the mesh criteria.
+ * @return void
+ */
+inline void Domain::refine_(const Mesh_criteria& criteria)
+{
+    map_ptr->freeze(number_of_surfaces());
+
+    std::cout << "Start refining" << std::endl;
+    run_with_threads([&]()
+    {
+       CGAL::refine_mesh_3(c3t3, *domain_ptr.get(), criteria, CGAL::parameters::no_exude(),
+                                                              CGAL::parameters::no_perturb());
+    });
+
+    invalidate_complex_index();
+    c3t3.rescan_after_load_of_triangulation();
+    rebind_missing_facets();
+    std::cout << "Done refining" << std::endl;
+}
+
+/**
+ * @brief Sets the cell size of a subdomain, used by create_mesh instead of the 
+ * global cell size. The size is also used for the facets of the subdomain boundary, 
+ * unless the interface has a size.
+ * @param tag the subdomain tag.
+ * @param cell_size the maximum cell size in the subdomain. 
+ * @return void
+ * @throws InvalidArgumentError if the size is not positive.
+ */
+inline void Domain::set_subdomain_size(int tag, double cell_size)
+{
+    if ( cell_size <= 0 )
+       throw InvalidArgumentError("The cell size must be positive.");
+    sizes->subdomains[tag] = cell_size;
+}
+
+/**
+ * @brief Sets the facet size of the interface between two subdomains, used by 
+ * create_mesh instead of the global facet size.
+ * @param interface pair of subdomain tags, in any order. 
+ * @param facet_size the maximum facet size in the interface. 
+ * @return void
+ * @throws InvalidArgumentError if the size is not positive.
+ */
+inline void Domain::set_interface_size(std::pair<int,int> interface, double facet_size)
+{
+    if ( facet_size <= 0 )
+       throw InvalidArgumentError("The facet size must be positive.");
+    sizes->interfaces[interface] = facet_size;
+}
+
+/**
+ * @brief Sets the edge size of a curve, i.e. the index of an added border or feature, 
+ * used by create_mesh instead of the global edge size.
+ * @param tag the curve tag. 
+ * @param edge_size the maximum edge size on the curve. 
+ * @return void
+ * @throws InvalidArgumentError if the size is not positive.
+ */
+inline void Domain::set_curve_size(int tag, double edge_size)
+{
+    if ( edge_size <= 0 )
+       throw InvalidArgumentError("The edge size must be positive.");
+    sizes->curves[tag] = edge_size;
+}
+
+/**
+ * @brief Updates the sizing report after create_mesh. 
+ *
+ * The number of cells in a mesh with the smallest cell size in all subdomains is 
+ * estimated by scaling the number of cells in each subdomain by the cube of the 
+ * ratio between its cell size and the smallest cell size. The report contains
+ * - cells, the number of cells in the mesh,
+ * - minimum_cell_size, the smallest cell size,
+ * - estimated_uniform_cells, the estimated number of cells with the smallest cell size,
+ * - estimated_savings, the estimated fraction of cells saved by the subdomain sizes.
+ * @param cell_size the global cell size.
+ * @return void
+ */
+inline void Domain::update_sizing_report_(double cell_size)
+{
+    double minimum_cell_size = cell_size;
+    for ( auto& it : sizes->subdomains )
+        minimum_cell_size = std::min(minimum_cell_size, it.second);
+
+    double cells = 0.0;
+    double uniform_cells = 0.0;
+    for ( auto& it : get_complex_index().subdomain_cells )
+    {
+        auto size = sizes->subdomains.find(it.first);
+        double ratio = ( size == sizes->subdomains.end() ? cell_size : size->second )/minimum_cell_size;
+        cells += static_cast<double>(it.second);
+        uniform_cells += static_cast<double>(it.second)*ratio*ratio*ratio;
+    }
+    sizing_report.clear();
+    sizing_report["cells"] = cells;
+    sizing_report["minimum_cell_size"] = minimum_cell_size;
+    sizing_report["estimated_uniform_cells"] = uniform_cells;
+    sizing_report["estimated_savings"] = uniform_cells > 0 ? 1.0 - cells/uniform_cells : 0.0;
+}
+
 /**
  * @brief Writes the mesh stored in the class member variable c3t3 to file.
  * 
@@ -1111,31 +2163,256 @@ inline void Domain::create_mesh(const double mesh_resolution )
  * If there are no interfaces in SubDomainMap, then default interfaces are 
  * selected.
  *
+ * The mesh is written in the binary medit format if the extension is .meshb,
+ * in XDMF with HDF5 if the extension is .xdmf, otherwise in the ascii medit format.
+ *
  * @param outpath the path to the output file.
  * @param save_1Dfeatures option to save the edges with tags.
+ * @param binary_version the binary medit version, 2 or 3, only used for .meshb.
+ */
+inline void Domain::save(std::string outpath,bool save_1Dfeatures, int binary_version)
+{
+    if ( outpath.substr(outpath.find_last_of(".")+1) == "xdmf" )
+    {
+       save_xdmf(outpath);
+       return;
+    }
+
+    Medit_mesh mesh = export_mesh(save_1Dfeatures);
+
+    if ( is_medit_binary(outpath) )
+    {
+       write_medit_binary(outpath, mesh, binary_version);
+       return;
+    }
+
+    std::ofstream  medit_file(outpath);
+    write_medit_ascii(medit_file, mesh);
+    medit_file.close();
+}
+
+/**
+ * @brief Writes the mesh stored in the class member variable c3t3 to XDMF, with 
+ * coordinates, tetrahedra, subdomain tags, and the interface facets with the tags 
+ * from SubdomainMap in a HDF5 file with the same name and the extension .h5.
+ *
+ * The XDMF file has the grid "mesh" with the cell attribute "subdomains", and 
+ * the grid "boundaries" with the cell attribute "boundaries".
+ *
+ * @param outpath the path to the XDMF file.
+ * @param compression_level gzip compression level 0-9 of the datasets, 0 is no compression.
+ * @param chunk_size number of rows in each chunk of the datasets, 0 is contiguous unless compressed. 
+ * @param include_interior_facets option to include the facets with tag 0 in the boundaries grid.
+ * @return void
+ * @throws PreconditionError if SVMTK is compiled without HDF5.
  */
-inline void Domain::save(std::string outpath,bool save_1Dfeatures)
+inline void Domain::save_xdmf(std::string outpath, int compression_level, std::size_t chunk_size, bool include_interior_facets)
+{
+    if ( !has_xdmf_support() )
+       throw PreconditionError("SVMTK is compiled without HDF5, XDMF export is not available.");
+    if ( compression_level < 0 or compression_level > 9 )
+       throw InvalidArgumentError("Compression level must be between 0 and 9.");
+
+    Xdmf_options options;
+    options.compression_level = compression_level;
+    options.chunk_size = chunk_size;
+    options.include_interior_facets = include_interior_facets;
+    write_xdmf(outpath, export_mesh(false), options);
+}
+
+/**
+ * @brief Exports the mesh stored in the class member variable c3t3 to flat arrays 
+ * of vertices, edges, triangles and tetrahedra with tags, as written by save.
+ *
+ * @param save_1Dfeatures option to export the edges with tags.
+ * @return mesh the mesh with tags and zero based vertex indices.
+ */
+inline Medit_mesh Domain::export_mesh(bool save_1Dfeatures)
 {
     assert_non_empty_mesh_object();
     
-    std::ofstream  medit_file(outpath);
     typedef CGAL::Mesh_3::Medit_pmap_generator<C3t3,false,false> Generator;
     typedef Generator::Cell_pmap Cell_pmap;
     typedef Generator::Facet_pmap Facet_pmap;
-    typedef Generator::Facet_pmap_twice Facet_pmap_twice;
     typedef Generator::Vertex_pmap Vertex_pmap;
  
     Cell_pmap cell_pmap(c3t3);
     Facet_pmap facet_pmap(c3t3, cell_pmap); 
-    Facet_pmap_twice  facet_twice_pmap(c3t3,cell_pmap);
     Vertex_pmap vertex_pmap(c3t3, cell_pmap,facet_pmap); // 
 
     std::map<std::pair<int,int>,int> facet_map = this->map_ptr->make_interfaces(this->get_patches());
     
+    Medit_mesh mesh;
+    run_with_number_of_threads(num_threads, [&](){ mesh = c3t3_to_medit_mesh_(c3t3, vertex_pmap, facet_map, cell_pmap, save_1Dfeatures); });
+    return mesh;
+}
 
-    
-    output_to_medit_(medit_file,c3t3, vertex_pmap, facet_map, cell_pmap, facet_twice_pmap , false, save_1Dfeatures) ;
-    medit_file.close();
+/**
+ * @brief Writes the mesh complex, borders and features to a binary checkpoint file, 
+ * that can be loaded into a Domain constructed from the same surfaces.
+ *
+ * The triangulation with the subdomain and surface patch indices is written with 
+ * CGAL binary mesh format, followed by the edges and corners in the complex, 
+ * and the borders and features.
+ *
+ * @param outpath the path to the checkpoint file.
+ * @return void
+ */
+inline void Domain::save_checkpoint(std::string outpath)
+{
+    assert_non_empty_mesh_object();
+
+    std::ofstream os(outpath, std::ios::binary);
+    if ( !os )
+       throw InvalidArgumentError("Could not open checkpoint file for writing.");
+
+    auto write_int = [&os](std::int64_t value) { os.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    auto write_point = [&os](double x, double y, double z) 
+    {
+       double xyz[3] = {x, y, z};
+       os.write(reinterpret_cast<const char*>(xyz), sizeof(xyz)); 
+    };
+    auto write_vertex = [&](const Vertex_handle& vh) 
+    { 
+       Weighted_point p = c3t3.triangulation().point(vh);
+       write_point(CGAL::to_double(p.x()), CGAL::to_double(p.y()), CGAL::to_double(p.z()));
+    };
+    auto write_polylines = [&](const Polylines& polylines)
+    {
+       write_int(polylines.size());
+       for ( auto& polyline : polylines )
+       {
+          write_int(polyline.size());
+          for ( auto& p : polyline )
+             write_point(CGAL::to_double(p.x()), CGAL::to_double(p.y()), CGAL::to_double(p.z()));
+       }
+    };
+
+    os << "SVMTK checkpoint 1\n";
+    write_int(number_of_surfaces());
+#if CGAL_VERSION_NR >= 1050301000
+    CGAL::IO::save_binary_file(os, c3t3);
+#else
+    CGAL::Mesh_3::save_binary_file(os, c3t3);
+#endif
+
+    write_int(c3t3.number_of_edges_in_complex());
+    for ( auto eit = c3t3.edges_in_complex_begin(); eit != c3t3.edges_in_complex_end(); ++eit )
+    {
+       write_vertex(eit->first->vertex(eit->second));
+       write_vertex(eit->first->vertex(eit->third));
+       write_int(c3t3.curve_index(*eit));
+    }
+    std::vector<Vertex_handle> corners;
+    for ( Finite_vertices_iterator vit = c3t3.triangulation().finite_vertices_begin(); vit != c3t3.triangulation().finite_vertices_end(); ++vit )
+    {
+       if ( c3t3.is_in_complex(vit) )
+          corners.push_back(vit);
+    }
+    write_int(corners.size());
+    for ( auto& vh : corners )
+    {
+       write_vertex(vh);
+       write_int(c3t3.corner_index(vh));
+    }
+    write_polylines(borders);
+    write_polylines(features);
+    if ( !os )
+       throw AlgorithmError("Failed to write checkpoint file.");
+}
+
+/**
+ * @brief Loads a checkpoint written by save_checkpoint, and replaces the mesh complex, 
+ * borders and features. The Domain must be constructed from the same surfaces as the 
+ * Domain that wrote the checkpoint.
+ *
+ * @param inpath the path to the checkpoint file.
+ * @return void
+ * @throws InvalidArgumentError if the file is not a checkpoint, or the number of surfaces differ.
+ */
+inline void Domain::load_checkpoint(std::string inpath)
+{
+    std::ifstream is(inpath, std::ios::binary);
+    if ( !is )
+       throw InvalidArgumentError("Could not open checkpoint file for reading.");
+
+    auto read_int = [&is]() { std::int64_t value = 0; is.read(reinterpret_cast<char*>(&value), sizeof(value)); return value; };
+    auto read_point = [&is]() 
+    {
+       std::array<double,3> xyz;
+       is.read(reinterpret_cast<char*>(xyz.data()), sizeof(double)*3);
+       return xyz; 
+    };
+    auto read_polylines = [&]()
+    {
+       Polylines polylines(read_int());
+       for ( auto& polyline : polylines )
+       {
+          polyline.resize(read_int());
+          for ( auto& p : polyline )
+          {
+             std::array<double,3> xyz = read_point();
+             p = Point_3(xyz[0], xyz[1], xyz[2]);
+          }
+       }
+       return polylines;
+    };
+
+    std::string header;
+    std::getline(is, header);
+    if ( header != "SVMTK checkpoint 1" )
+       throw InvalidArgumentError("Not a SVMTK checkpoint file.");
+    if ( read_int() != number_of_surfaces() )
+       throw InvalidArgumentError("Checkpoint is written by a Domain with a different number of surfaces.");
+
+    C3t3 loaded;
+#if CGAL_VERSION_NR >= 1050301000
+    bool ok = CGAL::IO::load_binary_file(is, loaded);
+#else
+    bool ok = CGAL::Mesh_3::load_binary_file(is, loaded);
+#endif
+    if ( !ok )
+       throw InvalidArgumentError("Failed to read the mesh in the checkpoint file.");
+
+    std::map<std::array<double,3>, Vertex_handle> vertices;
+    for ( auto vit = loaded.triangulation().finite_vertices_begin(); vit != loaded.triangulation().finite_vertices_end(); ++vit )
+    {
+       Weighted_point p = loaded.triangulation().point(vit);
+       vertices[{CGAL::to_double(p.x()), CGAL::to_double(p.y()), CGAL::to_double(p.z())}] = vit;
+    }
+    auto read_vertex = [&]() 
+    {
+       auto it = vertices.find(read_point());
+       if ( it == vertices.end() )
+          throw InvalidArgumentError("Checkpoint file is corrupted.");
+       return it->second;
+    };
+
+    for ( std::int64_t i = 0, n = read_int(); i < n; ++i )
+    {
+       Vertex_handle v1 = read_vertex();
+       Vertex_handle v2 = read_vertex();
+       Curve_index index = static_cast<Curve_index>(read_int());
+       if ( !loaded.is_in_complex(v1, v2) )
+          loaded.add_to_complex(v1, v2, index);
+    }
+    for ( std::int64_t i = 0, n = read_int(); i < n; ++i )
+    {
+       Vertex_handle v = read_vertex();
+       Corner_index index = static_cast<Corner_index>(read_int());
+       if ( !loaded.is_in_complex(v) )
+          loaded.add_to_complex(v, index);
+    }
+    Polylines loaded_borders = read_polylines();
+    Polylines loaded_features = read_polylines();
+    if ( !is )
+       throw InvalidArgumentError("Checkpoint file is truncated.");
+
+    c3t3.swap(loaded);
+    invalidate_complex_index();
+    borders.swap(loaded_borders);
+    features.swap(loaded_features);
+    invalidate_edge_index();
 }
 
 /**
@@ -1165,42 +2442,41 @@ inline void Domain::remove_subdomain(int tag)
 inline void Domain::remove_subdomain(std::vector<int> tags)
 {
   assert_non_empty_mesh_object();
+  if ( tags.empty() ) 
+     return;
   
   int before = c3t3.number_of_cells();
+
+  // Sorted tags to be removed, searched for each cell and neighbour.
+  std::sort(tags.begin(), tags.end());
+  tags.erase(std::unique(tags.begin(), tags.end()), tags.end());
+  auto is_removed = [&](const Subdomain_index& index)
+  {
+     return std::binary_search(tags.begin(), tags.end(), static_cast<int>(index));
+  };
+
+  // Collects the cells to be removed, and the facets (Cell_handle,int) with patches (int,int) 
+  // of the remaining cells that are connected to removed cells.
+  std::vector<Cell_handle> removed;
   std::vector<std::tuple<Cell_handle,int,int,int>> rebind;  
-  
-  // Iterate over subdomains to be removed, and stores connected facets (Cell_handle,int) and patches (int,int)
-  for( auto j = tags.begin(); j!=tags.end(); ++j)
+  for(C3t3::Cells_in_complex_iterator cit = c3t3.cells_in_complex_begin();cit != c3t3.cells_in_complex_end(); ++cit)
   {
-    Subdomain_index temp(*j) ; 
-    for(C3t3::Cells_in_complex_iterator cit = c3t3.cells_in_complex_begin();cit != c3t3.cells_in_complex_end(); ++cit)
+    Subdomain_index k = c3t3.subdomain_index(cit);
+    if ( is_removed(k) )
     {
-      int k = static_cast<int>(c3t3.subdomain_index(cit)) ;
-      for (std::size_t i = 0; i < 4; i++)
-      { 
-
-         if(std::find(tags.begin(), tags.end(), static_cast<int>(c3t3.subdomain_index(cit))  ) == tags.end() )          
-         {
-           if(c3t3.subdomain_index(cit->neighbor(i))==temp)
-           {         
-               rebind.push_back(std::make_tuple(cit, i,*j,k)); 
-           }
-         }
-      }
+       removed.push_back(cit);
+       continue;
+    }
+    for (int i = 0; i < 4; i++)
+    { 
+       Subdomain_index j = c3t3.subdomain_index(cit->neighbor(i));
+       if ( is_removed(j) )
+          rebind.push_back(std::make_tuple(cit, i, static_cast<int>(j), static_cast<int>(k))); 
     }
   }
 
-  // removes all cells with a subdomain tag   
-  for(std::vector<int>::iterator j = tags.begin(); j!=tags.end(); ++j)
-  {
-      for(auto cit =  c3t3.cells_in_complex_begin(Subdomain_index(*j));cit !=  c3t3.cells_in_complex_end(); ++cit)
-      {  
-         c3t3.remove_from_complex(cit); 
-      }     
-  }
-
-  c3t3.rescan_after_load_of_triangulation(); 
-  remove_isolated_vertices(true);
+  for ( auto& cell : removed )
+     c3t3.remove_from_complex(cell); 
 
   // Restore the patches and facets linked to deleted cells 
   for ( auto cit = rebind.begin(); cit!=rebind.end(); ++cit)
@@ -1220,19 +2496,64 @@ inline void Domain::remove_subdomain(std::vector<int> tags)
       }
 
   }
+  c3t3.rescan_after_load_of_triangulation(); 
+  invalidate_complex_index();
   int after = c3t3.number_of_cells();
 
   std::cout << "Number of removed subdomain cells : " << (before -after) << std::endl;
-  c3t3.rescan_after_load_of_triangulation(); 
 }
 
 
+/**
+ * @brief Adds the segments of borders and features that are not yet in the 
+ * segment index, and rebuilds the AABB tree of the index if segments are added.
+ *
+ * The index is rebuilt from scratch if it is invalidated, i.e. if borders or 
+ * features are removed or replaced.
+ * @param none
+ * @return void
+ */
+inline void Domain::update_edge_index_()
+{
+  if ( !edge_index_valid or indexed_borders > borders.size() or indexed_features > features.size() )
+  {
+     edge_segments.clear();
+     edge_endpoints.clear();
+     indexed_borders = 0;
+     indexed_features = 0;
+  }
+
+  const std::size_t before = edge_segments.size();
+  auto add_segments = [this](const Polyline_3& polyline)
+  {
+     for ( std::size_t i = 1; i < polyline.size(); ++i )
+     {
+        edge_segments.push_back(Segment_3(polyline[i-1], polyline[i]));
+        edge_endpoints.insert(std::minmax(polyline[i-1], polyline[i]));
+     }
+  };
+  for ( ; indexed_borders < borders.size(); ++indexed_borders )
+     add_segments(borders[indexed_borders]);
+  for ( ; indexed_features < features.size(); ++indexed_features )
+     add_segments(features[indexed_features]);
+
+  if ( !edge_index_valid or edge_segments.size() != before )
+  {
+     edge_tree.rebuild(edge_segments.begin(), edge_segments.end());
+  }
+  edge_index_valid = true;
+}
+
 /**
  *
  * @brief adds sharp border edges of polyhedron to mesh.
  *
  * Checks polyhedron for sharp edges, if these edges do not conflict/intersect
- * previously stored edges, then the edges are stored in this->borders.
+ * previously stored borders and features, then the edges are stored in this->borders.
+ * Edges that are already stored, e.g. shared by two polyhedra, are not added again. 
+ *
+ * The conflicts are found with an AABB tree of the segments of the stored borders 
+ * and features, which is updated when borders and features are added.
  *   
  * @note The use of 1D features in combination with ill-posed meshing paramteres can cause segmentation fault (crash). 
  *
@@ -1249,33 +2570,39 @@ inline void Domain::add_sharp_border_edges(Polyhedron& polyhedron, double thresh
  
  CGAL::Polygon_mesh_processing::detect_sharp_edges(polyhedron,threshold, eif); 
 
- Point_3  p1,p2;
- Polylines temp;
-
- bool intersecting=false;
+ std::vector<Segment_3> sharp_edges;
  for(boost::graph_traits<Polyhedron>::edge_descriptor e : edges(polyhedron))
  {
     if(get(eif, e))
+       sharp_edges.push_back(Segment_3(source(e,polyhedron)->point(), target(e,polyhedron)->point()));
+ }
+
+ update_edge_index_();
+
+ // 0 is added, 1 is already stored and 2 is in conflict with stored edges.
+ std::vector<char> status(sharp_edges.size(), 0);
+ run_with_number_of_threads(num_threads, [&]()
+ {
+    parallel_for_each_index(sharp_edges.size(), [&](std::size_t i)
     {
-       Polyline_3 polyline;
-
-       p1 = source(e,polyhedron)->point();
-       p2 = target(e,polyhedron)->point();
-      
-       polyline={p1,p2};
-       intersecting=false;
-       for ( auto pline : this->borders ) 
-       {
-           if (CGAL::Polygon_mesh_processing::do_intersect(polyline,pline)) 
-              intersecting=true;      
-       } 
-       if (!intersecting)
-          temp.push_back(polyline);
-    
-    }
+       const Segment_3& segment = sharp_edges[i];
+       if ( edge_endpoints.count(std::minmax(segment.source(), segment.target())) )
+          status[i] = 1;
+       else if ( edge_tree.do_intersect(segment) )
+          status[i] = 2;
+    });
+ });
+
+ Polylines temp;
+ std::size_t conflicts = 0;
+ for ( std::size_t i = 0; i < sharp_edges.size(); ++i )
+ {
+    if ( status[i] == 0 )
+       temp.push_back(Polyline_3{sharp_edges[i].source(), sharp_edges[i].target()});
+    conflicts += ( status[i] == 2 );
  }
 
- if (temp.size()==0)
+ if (temp.size()==0 and conflicts > 0)
    std::cout <<"Warning, new edges intersects with existing edges."<<std::endl;
  else
    this->borders.insert(this->borders.end(),temp.begin(),temp.end());    
@@ -1345,6 +2672,7 @@ inline void Domain::protect_borders()
       return;
    else 
       this->borders = temp;
+   invalidate_edge_index();
 }
 
 /**
@@ -1355,10 +2683,8 @@ inline void Domain::protect_borders()
 std::set<int>  Domain::get_subdomains()
 {
    std::set<int> sd_indices;
-   for(Cell_iterator cit = c3t3.cells_in_complex_begin();cit != c3t3.cells_in_complex_end(); ++cit)
-   {
-        sd_indices.insert(static_cast<int>(c3t3.subdomain_index(cit)) );
-   }
+   for ( auto& it : get_complex_index().subdomain_cells )
+        sd_indices.insert(it.first);
    return sd_indices;
 }
 
@@ -1370,20 +2696,8 @@ std::set<int>  Domain::get_subdomains()
 std::vector<std::pair<int,int>>  Domain::get_patches()
 {
    std::vector<std::pair<int,int>> sf_indices;
-   std::set<std::pair<int,int>> dummy;
-   for(Cell_iterator cit = c3t3.cells_in_complex_begin();cit != c3t3.cells_in_complex_end(); ++cit)
-   {
-      for( int i =0 ; i<4 ; ++i)
-      {
-         Surface_patch_index spi = c3t3.surface_patch_index(cit,i) ;
-
-         if (dummy.insert(std::pair<int,int>(static_cast<int>(spi.first) , static_cast<int>(spi.second) )).second and spi.first!=spi.second )
-          {   sf_indices.push_back(std::pair<int,int>(static_cast<int>(spi.first) , static_cast<int>(spi.second) ));
-
-          }
-      }
-   }
-   std::sort(sf_indices.begin() ,sf_indices.end()) ;
+   for ( auto& it : get_complex_index().patch_facets )
+        sf_indices.push_back(it.first);
    return sf_indices;
 }
 
@@ -1409,28 +2723,43 @@ std::shared_ptr<Surface> Domain::get_boundary(int tag)
 /**
  * @brief Iterates over all surface boundaries of subdomains and stores and returns it as a vector of Surface objects.   
  *
+ * The facets of all patches are taken from the complex index, and converted to 
+ * triangle soups in one pass. The Surface objects are constructed in parallel, 
+ * if SVMTK is built with TBB.
+ *
  * @tparam SVMTK Surface object    
  * @param none 
- * @return patches vector of Surface objects 
+ * @return patches vector of Surface objects, in the order of get_patches.
  */
 template<typename Surface>
 std::vector<std::shared_ptr<Surface>> Domain::get_boundaries() 
 { 
-   
    std::vector<Point_3> points;
-   std::vector<Face> faces;
-   std::vector<std::shared_ptr<Surface>> patches;
-   for ( auto i : get_patches() ) 
+   std::vector<std::vector<Face>> patch_faces;
+   patch_facets_to_triangle_soups_(c3t3, get_complex_index().patch_facets, points, patch_faces);
+
+   std::vector<std::shared_ptr<Surface>> patches(patch_faces.size());
+   run_with_number_of_threads(num_threads, [&]()
    {
-      points.clear(); 
-      faces.clear();
-      if (i.first != i.second)
-      { 
-         facets_in_complex_3_to_triangle_soup_(c3t3,Surface_patch_index(i.first,i.second),points,faces);
-         std::shared_ptr<Surface> surf(new Surface(points,faces)); 
-         patches.push_back(surf);
-      }
-   }
+      parallel_for_each_index(patch_faces.size(), [&](std::size_t k)
+      {
+         // Renumbers the shared vertices of the patch.
+         std::vector<Face>& faces = patch_faces[k];
+         std::unordered_map<std::size_t,std::size_t> local;
+         std::vector<Point_3> patch_points;
+         for ( Face& f : faces )
+         {
+            for ( std::size_t& id : f )
+            {
+               auto it = local.insert(std::make_pair(id, patch_points.size()));
+               if ( it.second )
+                  patch_points.push_back(points[id]);
+               id = it.first->second;
+            }
+         }
+         patches[k] = std::make_shared<Surface>(patch_points, faces);
+      });
+   });
    return patches;
 }
 
@@ -1438,15 +2767,20 @@ std::vector<std::shared_ptr<Surface>> Domain::get_boundaries()
 template<typename Surface>
 std::shared_ptr<Surface> Domain::get_interface(std::pair<int,int> interface ) 
 { 
-   
    std::vector<Point_3> points;
    std::vector<Face> faces;
-   std::vector<std::shared_ptr<Surface>> patches;
 
    if (interface.first == interface.second)
        throw InvalidArgumentError("There are no interfaces between similar tags.") ;
 
-   facets_in_complex_3_to_triangle_soup_(c3t3,Surface_patch_index(interface.first,interface.second),points,faces);
+   const Complex_index& index = get_complex_index();
+   auto facets_it = index.patch_facets.find(interface);
+   if ( facets_it != index.patch_facets.end() )
+   {
+      std::vector<std::vector<Face>> patch_faces;
+      patch_facets_to_triangle_soups_(c3t3, std::map<std::pair<int,int>,std::vector<Facet>>{*facets_it}, points, patch_faces);
+      faces = std::move(patch_faces[0]);
+   }
    std::shared_ptr<Surface> surf(new Surface(points,faces)); 
 
    return surf;
@@ -1469,7 +2803,7 @@ std::shared_ptr<Surface> Domain::get_interface(std::pair<int,int> interface )
 inline void Domain::lloyd(double time_limit, int max_iteration_number, double convergence,double freeze_bound, bool do_freeze )
 {   assert_non_empty_mesh_object();
 
-CGAL::lloyd_optimize_mesh_3(c3t3, *domain_ptr.get(), time_limit=time_limit, max_iteration_number=max_iteration_number,convergence=convergence, freeze_bound  = freeze_bound, do_freeze = do_freeze); } 
+run_with_threads([&](){ CGAL::lloyd_optimize_mesh_3(c3t3, *domain_ptr.get(), time_limit=time_limit, max_iteration_number=max_iteration_number,convergence=convergence, freeze_bound  = freeze_bound, do_freeze = do_freeze);}); invalidate_complex_index(); } 
 
 /**
  * @brief CGAL function for odt optimazation of the constructed mesh.  
@@ -1486,6 +2820,125 @@ CGAL::lloyd_optimize_mesh_3(c3t3, *domain_ptr.get(), time_limit=time_limit, max_
 inline void Domain::odt(double time_limit, int max_iteration_number, double convergence,double freeze_bound, bool do_freeze) 
 {   assert_non_empty_mesh_object();
 
-CGAL::odt_optimize_mesh_3(c3t3, *domain_ptr.get(), time_limit=time_limit, max_iteration_number=max_iteration_number,convergence=convergence, freeze_bound  = freeze_bound, do_freeze = do_freeze); } 
+run_with_threads([&](){ CGAL::odt_optimize_mesh_3(c3t3, *domain_ptr.get(), time_limit=time_limit, max_iteration_number=max_iteration_number,convergence=convergence, freeze_bound  = freeze_bound, do_freeze = do_freeze);}); invalidate_complex_index(); } 
+
+/**
+ * @brief Returns the minimum dihedral angle and the minimum radius ratio of the cells in the complex. 
+ * @param none
+ * @return a pair with the minimum dihedral angle in degrees and the minimum radius ratio.
+ */
+inline std::pair<double,double> Domain::minimum_quality_()
+{
+  const Tr& tr = c3t3.triangulation();
+  std::vector<Cell_handle> cells = get_cells_in_complex();
+  std::vector<std::pair<double,double>> values(cells.size());
+  run_with_number_of_threads(num_threads, [&]()
+  {
+     parallel_for_each_index(cells.size(), [&](std::size_t i)
+     {
+        std::array<std::array<double,3>,4> points;
+        for ( int j = 0; j < 4; ++j )
+        {
+           const Weighted_point& p = tr.point(cells[i], j);
+           points[j] = {CGAL::to_double(p.x()), CGAL::to_double(p.y()), CGAL::to_double(p.z())};
+        }
+        Tetrahedron_quality quality = tetrahedron_quality(points);
+        values[i] = std::make_pair(quality.min_dihedral_angle, quality.radius_ratio);
+     });
+  });
+  std::pair<double,double> result(180.0, 1.0);
+  for ( auto& value : values )
+  {
+     result.first  = std::min(result.first, value.first);
+     result.second = std::min(result.second, value.second);
+  }
+  return result;
+}
+
+/**
+ * @brief Runs mesh optimization stages in a valid order with a shared time budget.
+ *
+ * The stages are run in the order lloyd, odt, perturb and exude regardless of the 
+ * order given, since lloyd and odt fail after exude. Each stage is given the 
+ * remaining time of the budget, and the optimization stops before a stage if the 
+ * budget is spent or if all given quality targets are met. The dihedral angle target
+ * is also used as the sliver bound of perturb and exude.
+ *
+ * Each stage reports: 
+ * - time, the wall-clock time of the stage in seconds,
+ * - return_code, the CGAL::Mesh_optimization_return_code of the stage,
+ * - min_dihedral_angle_before, min_dihedral_angle_after and min_dihedral_angle_delta,
+ * - min_radius_ratio_before, min_radius_ratio_after and min_radius_ratio_delta,
+ * - remaining_time, the remaining time of the budget, or 0 without a budget.
+ *
+ * @param stages the names of the stages, any of "lloyd", "odt", "perturb" and "exude".
+ * @param time_budget the total wall-clock time in seconds, 0 for no limit.
+ * @param min_dihedral_angle the target minimum dihedral angle in degrees, 0 for no target.
+ * @param min_radius_ratio the target minimum radius ratio, 0 for no target.
+ * @return the name and report of each stage that was run.
+ * @throws InvalidArgumentError if a stage is unknown or given twice.
+ */
+inline std::vector<std::pair<std::string,Parameters>> Domain::optimize(std::vector<std::string> stages, double time_budget,
+                                                                      double min_dihedral_angle, double min_radius_ratio)
+{
+  assert_non_empty_mesh_object();
+  static const std::vector<std::string> order = {"lloyd", "odt", "perturb", "exude"};
+  for ( auto& stage : stages )
+  {
+     if ( std::find(order.begin(), order.end(), stage) == order.end() )
+        throw InvalidArgumentError("Unknown optimization stage, use lloyd, odt, perturb or exude.");
+     if ( std::count(stages.begin(), stages.end(), stage) > 1 )
+        throw InvalidArgumentError("Optimization stage given more than once.");
+  }
+  std::sort(stages.begin(), stages.end(), [](const std::string& a, const std::string& b)
+  { return std::find(order.begin(), order.end(), a) < std::find(order.begin(), order.end(), b); });
+
+  const bool has_target = min_dihedral_angle > 0 or min_radius_ratio > 0;
+  const double sliver_bound = std::max(min_dihedral_angle, 0.0);
+  const auto start = std::chrono::steady_clock::now();
+  auto elapsed = [&start]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+
+  std::vector<std::pair<std::string,Parameters>> reports;
+  std::pair<double,double> quality = minimum_quality_();
+  for ( auto& stage : stages )
+  {
+     if ( has_target and quality.first >= min_dihedral_angle and quality.second >= min_radius_ratio )
+        break;
+     const double time_limit = time_budget > 0 ? time_budget - elapsed() : 0;
+     if ( time_budget > 0 and time_limit <= 0 )
+        break;
+
+     const auto stage_start = std::chrono::steady_clock::now();
+     CGAL::Mesh_optimization_return_code code;
+     run_with_threads([&]()
+     {
+        if ( stage == "lloyd" )
+           code = CGAL::lloyd_optimize_mesh_3(c3t3, *domain_ptr.get(), CGAL::parameters::time_limit=time_limit);
+        else if ( stage == "odt" )
+           code = CGAL::odt_optimize_mesh_3(c3t3, *domain_ptr.get(), CGAL::parameters::time_limit=time_limit);
+        else if ( stage == "perturb" )
+           code = CGAL::perturb_mesh_3(c3t3, *domain_ptr.get(), CGAL::parameters::time_limit=time_limit, CGAL::parameters::sliver_bound=sliver_bound);
+        else
+           code = CGAL::exude_mesh_3(c3t3, CGAL::parameters::sliver_bound=sliver_bound, CGAL::parameters::time_limit=time_limit);
+     });
+     const double stage_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - stage_start).count();
+     invalidate_complex_index();
+
+     std::pair<double,double> after = minimum_quality_();
+     Parameters report;
+     report["time"] = stage_time;
+     report["return_code"] = static_cast<double>(code);
+     report["min_dihedral_angle_before"] = quality.first;
+     report["min_dihedral_angle_after"]  = after.first;
+     report["min_dihedral_angle_delta"]  = after.first - quality.first;
+     report["min_radius_ratio_before"]   = quality.second;
+     report["min_radius_ratio_after"]    = after.second;
+     report["min_radius_ratio_delta"]    = after.second - quality.second;
+     report["remaining_time"] = time_budget > 0 ? std::max(time_budget - elapsed(), 0.0) : 0.0;
+     reports.emplace_back(stage, report);
+     quality = after;
+  }
+  return reports;
+}
 
 #endif
@@ -0,0 +1,437 @@
+// Copyright (C) 2018-2021 Lars Magnus Valnes
+//
+// This file is part of Surface Volume Meshing Toolkit (SVM-TK).
+//
+// SVM-Tk is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SVM-Tk is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SVM-Tk.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef Medit_H
+
+#define Medit_H
+/* --- Includes -- */
+#include "Errors.h"
+
+/* -- STL -- */
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * \struct
+ *
+ * @brief Tetrahedral mesh stored as flat arrays with a tag for each element,
+ * as written to the medit file format. The vertex indices are zero based.
+ */
+struct Medit_mesh
+{
+      std::vector<double> vertices;         // x y z for each vertex
+      std::vector<int> vertex_tags;
+      std::vector<int> edges;               // 2 vertex indices for each edge
+      std::vector<int> edge_tags;
+      std::vector<int> triangles;           // 3 vertex indices for each triangle
+      std::vector<int> triangle_tags;
+      std::vector<int> tetrahedra;          // 4 vertex indices for each tetrahedron
+      std::vector<int> tetrahedron_tags;
+
+      std::size_t number_of_vertices() const { return vertex_tags.size(); }
+      std::size_t number_of_edges() const { return edge_tags.size(); }
+      std::size_t number_of_triangles() const { return triangle_tags.size(); }
+      std::size_t number_of_tetrahedra() const { return tetrahedron_tags.size(); }
+};
+
+/**
+ * Keywords and codes of the binary medit format (libMeshb).
+ */
+namespace Medit_keyword
+{
+      const std::int32_t Code       = 1;
+      const std::int32_t Dimension  = 3;
+      const std::int32_t Vertices   = 4;
+      const std::int32_t Edges      = 5;
+      const std::int32_t Triangles  = 6;
+      const std::int32_t Tetrahedra = 8;
+      const std::int32_t End        = 54;
+}
+
+/**
+ * @brief Returns true if the file path has the extension .meshb
+ * @param path the file path.
+ * @return true if binary medit file.
+ */
+inline bool is_medit_binary(const std::string& path)
+{
+   std::string::size_type pos = path.find_last_of(".");
+   return pos != std::string::npos and path.substr(pos+1) == "meshb";
+}
+
+/**
+ * \class
+ *
+ * @brief Writes a binary medit file block by block, where each block
+ * is buffered and written with a single call.
+ *
+ * Version 2 stores positions as 32 bit integers, and is limited to 2 GB files.
+ * Version 3 stores positions as 64 bit integers.
+ */
+class Medit_binary_writer
+{
+   public:
+        Medit_binary_writer(const std::string& path, int version) : os(path, std::ios::binary), version(version)
+        {
+           if ( version != 2 and version != 3 )
+              throw InvalidArgumentError("Binary medit version must be 2 or 3.");
+           if ( !os )
+              throw InvalidArgumentError("Could not open file for writing.");
+           put<std::int32_t>(Medit_keyword::Code);
+           put<std::int32_t>(version);
+           flush();
+        }
+
+        /**
+         * @brief Writes the dimension keyword.
+         * @param dimension the geometric dimension.
+         * @return void
+         */
+        void write_dimension(int dimension)
+        {
+           begin_keyword(Medit_keyword::Dimension, sizeof(std::int32_t));
+           put<std::int32_t>(dimension);
+           flush();
+        }
+
+        /**
+         * @brief Writes a block of elements with a tag for each element.
+         * @param keyword the medit keyword of the block.
+         * @param indices zero based vertex indices, nodes per element for each element.
+         * @param tags the tag of each element.
+         * @param nodes the number of vertices in each element.
+         * @return void
+         */
+        void write_elements(std::int32_t keyword, const std::vector<int>& indices, const std::vector<int>& tags, std::size_t nodes)
+        {
+           const std::size_t n = tags.size();
+           begin_keyword(keyword, sizeof(std::int32_t) + n*(nodes+1)*sizeof(std::int32_t));
+           put<std::int32_t>(static_cast<std::int32_t>(n));
+           for ( std::size_t i = 0; i < n; ++i )
+           {
+              for ( std::size_t j = 0; j < nodes; ++j )
+                 put<std::int32_t>(indices[nodes*i+j]+1);
+              put<std::int32_t>(tags[i]);
+           }
+           flush();
+        }
+
+        /**
+         * @brief Writes the vertices with a tag for each vertex.
+         * @param vertices x y z for each vertex.
+         * @param tags the tag of each vertex.
+         * @return void
+         */
+        void write_vertices(const std::vector<double>& vertices, const std::vector<int>& tags)
+        {
+           const std::size_t n = tags.size();
+           begin_keyword(Medit_keyword::Vertices, sizeof(std::int32_t) + n*(3*sizeof(double)+sizeof(std::int32_t)));
+           put<std::int32_t>(static_cast<std::int32_t>(n));
+           for ( std::size_t i = 0; i < n; ++i )
+           {
+              put<double>(vertices[3*i]);
+              put<double>(vertices[3*i+1]);
+              put<double>(vertices[3*i+2]);
+              put<std::int32_t>(tags[i]);
+           }
+           flush();
+        }
+
+        /**
+         * @brief Writes the end keyword and closes the file.
+         * @param none
+         * @return void
+         */
+        void close()
+        {
+           put<std::int32_t>(Medit_keyword::End);
+           put_position(0);
+           flush();
+           os.close();
+        }
+
+   private:
+        template<typename T>
+        void put(T value)
+        {
+           const char* bytes = reinterpret_cast<const char*>(&value);
+           buffer.insert(buffer.end(), bytes, bytes+sizeof(T));
+        }
+
+        void put_position(std::uint64_t position)
+        {
+           if ( version == 2 )
+           {
+              if ( position > static_cast<std::uint64_t>(INT32_MAX) )
+                 throw AlgorithmError("Mesh is too large for binary medit version 2, use version 3.");
+              put<std::int32_t>(static_cast<std::int32_t>(position));
+           }
+           else
+              put<std::int64_t>(static_cast<std::int64_t>(position));
+        }
+
+        void begin_keyword(std::int32_t keyword, std::size_t size)
+        {
+           const std::size_t header = sizeof(std::int32_t) + (version == 2 ? sizeof(std::int32_t) : sizeof(std::int64_t));
+           put<std::int32_t>(keyword);
+           put_position(written + header + size);
+           buffer.reserve(buffer.size() + size);
+        }
+
+        void flush()
+        {
+           os.write(buffer.data(), buffer.size());
+           written += buffer.size();
+           buffer.clear();
+        }
+
+        std::ofstream os;
+        int version;
+        std::uint64_t written = 0;
+        std::vector<char> buffer;
+};
+
+/**
+ * @brief Writes a mesh to a binary medit file (.meshb).
+ * @param path the path to the output file.
+ * @param mesh the mesh with tags.
+ * @param version the binary medit version, 2 or 3.
+ * @return void
+ */
+inline void write_medit_binary(const std::string& path, const Medit_mesh& mesh, int version = 3)
+{
+   Medit_binary_writer writer(path, version);
+   writer.write_dimension(3);
+   writer.write_vertices(mesh.vertices, mesh.vertex_tags);
+   if ( !mesh.edge_tags.empty() )
+      writer.write_elements(Medit_keyword::Edges, mesh.edges, mesh.edge_tags, 2);
+   writer.write_elements(Medit_keyword::Triangles, mesh.triangles, mesh.triangle_tags, 3);
+   writer.write_elements(Medit_keyword::Tetrahedra, mesh.tetrahedra, mesh.tetrahedron_tags, 4);
+   writer.close();
+}
+
+/**
+ * @brief Writes a mesh to an ascii medit file (.mesh).
+ * @param os the output stream.
+ * @param mesh the mesh with tags.
+ * @return void
+ */
+inline void write_medit_ascii(std::ostream& os, const Medit_mesh& mesh)
+{
+   auto write_elements = [&os](const char* keyword, const std::vector<int>& indices, const std::vector<int>& tags, std::size_t nodes)
+   {
+      os << keyword << '\n' << tags.size() << '\n';
+      for ( std::size_t i = 0; i < tags.size(); ++i )
+      {
+         for ( std::size_t j = 0; j < nodes; ++j )
+            os << indices[nodes*i+j]+1 << ' ';
+         os << tags[i] << '\n';
+      }
+   };
+
+   os << std::setprecision(17);
+   os << "MeshVersionFormatted 1\n"
+      << "Dimension 3\n";
+   os << "Vertices\n" << mesh.number_of_vertices() << '\n';
+   for ( std::size_t i = 0; i < mesh.number_of_vertices(); ++i )
+      os << mesh.vertices[3*i] << ' ' << mesh.vertices[3*i+1] << ' ' << mesh.vertices[3*i+2] << ' ' << mesh.vertex_tags[i] << '\n';
+   if ( !mesh.edge_tags.empty() )
+      write_elements("Edges", mesh.edges, mesh.edge_tags, 2);
+   write_elements("Triangles", mesh.triangles, mesh.triangle_tags, 3);
+   write_elements("Tetrahedra", mesh.tetrahedra, mesh.tetrahedron_tags, 4);
+   os << "End\n";
+}
+
+/**
+ * @brief Reads a mesh from a binary medit file (.meshb), version 1 to 3.
+ * Unknown keywords are skipped.
+ * @param path the path to the input file.
+ * @return mesh the mesh with tags.
+ * @throws InvalidArgumentError if the file is not a binary medit file.
+ */
+inline Medit_mesh read_medit_binary(const std::string& path)
+{
+   std::ifstream is(path, std::ios::binary);
+   if ( !is )
+      throw InvalidArgumentError("Could not open file for reading.");
+
+   auto get_int = [&is]() { std::int32_t value; is.read(reinterpret_cast<char*>(&value), sizeof(value)); return value; };
+
+   Medit_mesh mesh;
+   std::int32_t code = get_int();
+   std::int32_t version = get_int();
+   if ( !is or code != Medit_keyword::Code )
+      throw InvalidArgumentError("Not a binary medit file, or different byte order.");
+   if ( version < 1 or version > 3 )
+      throw InvalidArgumentError("Binary medit version is not supported.");
+
+   auto get_position = [&is,&get_int,version]() -> std::int64_t
+   {
+      if ( version < 3 )
+         return get_int();
+      std::int64_t value;
+      is.read(reinterpret_cast<char*>(&value), sizeof(value));
+      return value;
+   };
+   auto get_real = [&is,version]() -> double
+   {
+      if ( version == 1 )
+      {
+         float value;
+         is.read(reinterpret_cast<char*>(&value), sizeof(value));
+         return value;
+      }
+      double value;
+      is.read(reinterpret_cast<char*>(&value), sizeof(value));
+      return value;
+   };
+   while ( is )
+   {
+      std::int32_t keyword = get_int();
+      if ( !is or keyword == Medit_keyword::End )
+         break;
+      std::int64_t next = get_position();
+      switch ( keyword )
+      {
+         case Medit_keyword::Dimension:
+         {
+            if ( get_int() != 3 )
+               throw InvalidArgumentError("Only 3D binary medit files are supported.");
+            break;
+         }
+         case Medit_keyword::Vertices:
+         {
+            std::size_t n = static_cast<std::size_t>(get_int());
+            mesh.vertices.resize(3*n);
+            mesh.vertex_tags.resize(n);
+            for ( std::size_t i = 0; i < n; ++i )
+            {
+               mesh.vertices[3*i]   = get_real();
+               mesh.vertices[3*i+1] = get_real();
+               mesh.vertices[3*i+2] = get_real();
+               mesh.vertex_tags[i]  = get_int();
+            }
+            break;
+         }
+         case Medit_keyword::Edges:
+         case Medit_keyword::Triangles:
+         case Medit_keyword::Tetrahedra:
+         {
+            std::vector<int>& indices = keyword == Medit_keyword::Edges     ? mesh.edges :
+                                        keyword == Medit_keyword::Triangles ? mesh.triangles : mesh.tetrahedra;
+            std::vector<int>& tags    = keyword == Medit_keyword::Edges     ? mesh.edge_tags :
+                                        keyword == Medit_keyword::Triangles ? mesh.triangle_tags : mesh.tetrahedron_tags;
+            const std::size_t nodes   = keyword == Medit_keyword::Edges     ? 2 :
+                                        keyword == Medit_keyword::Triangles ? 3 : 4;
+            std::size_t n = static_cast<std::size_t>(get_int());
+            std::vector<std::int32_t> block((nodes+1)*n);
+            is.read(reinterpret_cast<char*>(block.data()), block.size()*sizeof(std::int32_t));
+            indices.resize(nodes*n);
+            tags.resize(n);
+            for ( std::size_t i = 0; i < n; ++i )
+            {
+               for ( std::size_t j = 0; j < nodes; ++j )
+                  indices[nodes*i+j] = block[(nodes+1)*i+j] - 1;
+               tags[i] = block[(nodes+1)*i+nodes];
+            }
+            break;
+         }
+         default:
+         {
+            if ( next <= 0 )
+               throw InvalidArgumentError("Unknown keyword in binary medit file.");
+            is.seekg(next);
+         }
+      }
+   }
+   if ( is.bad() )
+      throw InvalidArgumentError("Error while reading binary medit file.");
+   return mesh;
+}
+
+/**
+ * @brief Reads a mesh from an ascii medit file (.mesh) with the keywords
+ * Vertices, Edges, Triangles and Tetrahedra. Other keywords are skipped.
+ * @param path the path to the input file.
+ * @return mesh the mesh with tags.
+ */
+inline Medit_mesh read_medit_ascii(const std::string& path)
+{
+   std::ifstream is(path);
+   if ( !is )
+      throw InvalidArgumentError("Could not open file for reading.");
+
+   Medit_mesh mesh;
+   auto get_elements = [&is](std::vector<int>& indices, std::vector<int>& tags, std::size_t nodes)
+   {
+      std::size_t n;
+      is >> n;
+      indices.resize(nodes*n);
+      tags.resize(n);
+      for ( std::size_t i = 0; i < n; ++i )
+      {
+         for ( std::size_t j = 0; j < nodes; ++j )
+         {
+            is >> indices[nodes*i+j];
+            indices[nodes*i+j]--;
+         }
+         is >> tags[i];
+      }
+   };
+
+   std::string keyword;
+   while ( is >> keyword )
+   {
+      if ( keyword == "End" )
+         break;
+      else if ( keyword == "Vertices" )
+      {
+         std::size_t n;
+         is >> n;
+         mesh.vertices.resize(3*n);
+         mesh.vertex_tags.resize(n);
+         for ( std::size_t i = 0; i < n; ++i )
+            is >> mesh.vertices[3*i] >> mesh.vertices[3*i+1] >> mesh.vertices[3*i+2] >> mesh.vertex_tags[i];
+      }
+      else if ( keyword == "Edges" )
+         get_elements(mesh.edges, mesh.edge_tags, 2);
+      else if ( keyword == "Triangles" )
+         get_elements(mesh.triangles, mesh.triangle_tags, 3);
+      else if ( keyword == "Tetrahedra" )
+         get_elements(mesh.tetrahedra, mesh.tetrahedron_tags, 4);
+   }
+   return mesh;
+}
+
+/**
+ * @brief Reads a mesh from a medit file, binary if the extension is .meshb,
+ * otherwise ascii.
+ * @param path the path to the input file.
+ * @return mesh the mesh with tags.
+ */
+inline Medit_mesh read_medit(const std::string& path)
+{
+   if ( is_medit_binary(path) )
+      return read_medit_binary(path);
+   return read_medit_ascii(path);
+}
+
+#endif
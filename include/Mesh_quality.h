@@ -0,0 +1,356 @@
+// Copyright (C) 2018-2021 Lars Magnus Valnes
+//
+// This file is part of Surface Volume Meshing Toolkit (SVM-TK).
+//
+// SVM-Tk is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SVM-Tk is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SVM-Tk.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef Mesh_quality_H
+
+#define Mesh_quality_H
+/* --- Includes -- */
+#include "Errors.h"
+#include "Parallel.h"
+
+/* -- STL -- */
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <string>
+#include <vector>
+
+/**
+ * \struct
+ *
+ * @brief Quality metrics of a tetrahedron.
+ *
+ * The dihedral angles are in degrees. The radius ratio is 3 times the inradius
+ * divided by the circumradius, the edge ratio is the longest divided by the
+ * shortest edge, and the aspect ratio is the longest edge divided by 2*sqrt(6)
+ * times the inradius. All ratios are 1 for the regular tetrahedron.
+ * The volume is signed, and positive for positively oriented tetrahedra.
+ */
+struct Tetrahedron_quality
+{
+      double min_dihedral_angle;
+      double max_dihedral_angle;
+      double radius_ratio;
+      double edge_ratio;
+      double volume;
+      double aspect_ratio;
+};
+
+/**
+ * @brief Computes the quality metrics of a tetrahedron.
+ * @param p the four vertices of the tetrahedron.
+ * @return quality the quality metrics of the tetrahedron.
+ */
+inline Tetrahedron_quality tetrahedron_quality(const std::array<std::array<double,3>,4>& p)
+{
+   typedef std::array<double,3> Vec;
+   auto sub   = [](const Vec& a, const Vec& b) { return Vec{a[0]-b[0], a[1]-b[1], a[2]-b[2]}; };
+   auto dot   = [](const Vec& a, const Vec& b) { return a[0]*b[0] + a[1]*b[1] + a[2]*b[2]; };
+   auto cross = [](const Vec& a, const Vec& b) { return Vec{a[1]*b[2]-a[2]*b[1], a[2]*b[0]-a[0]*b[2], a[0]*b[1]-a[1]*b[0]}; };
+   auto norm  = [&dot](const Vec& a) { return std::sqrt(dot(a,a)); };
+
+   Tetrahedron_quality quality;
+   const Vec a = sub(p[1],p[0]);
+   const Vec b = sub(p[2],p[0]);
+   const Vec c = sub(p[3],p[0]);
+   const double det = dot(a, cross(b,c));
+   quality.volume = det/6.0;
+
+   double min_edge = std::numeric_limits<double>::max();
+   double max_edge = 0.0;
+   for ( int i = 0; i < 3; ++i )
+   {
+      for ( int j = i+1; j < 4; ++j )
+      {
+         double length = norm(sub(p[i],p[j]));
+         min_edge = std::min(min_edge, length);
+         max_edge = std::max(max_edge, length);
+      }
+   }
+   quality.edge_ratio = min_edge > 0 ? max_edge/min_edge : std::numeric_limits<double>::infinity();
+
+   // Outward normals of the faces opposite to each vertex.
+   std::array<Vec,4> normals;
+   double area = 0.0;
+   for ( int k = 0; k < 4; ++k )
+   {
+      const Vec& q0 = p[(k+1)%4];
+      const Vec& q1 = p[(k+2)%4];
+      const Vec& q2 = p[(k+3)%4];
+      Vec n = cross(sub(q1,q0), sub(q2,q0));
+      if ( dot(n, sub(p[k],q0)) > 0 )
+         n = Vec{-n[0], -n[1], -n[2]};
+      double length = norm(n);
+      area += 0.5*length;
+      normals[k] = length > 0 ? Vec{n[0]/length, n[1]/length, n[2]/length} : Vec{0,0,0};
+   }
+
+   // The dihedral angle at the edge shared by the faces opposite to k and l.
+   quality.min_dihedral_angle = 180.0;
+   quality.max_dihedral_angle = 0.0;
+   for ( int k = 0; k < 3; ++k )
+   {
+      for ( int l = k+1; l < 4; ++l )
+      {
+         double cosine = std::max(-1.0, std::min(1.0, dot(normals[k], normals[l])));
+         double angle = 180.0 - std::acos(cosine)*180.0/M_PI;
+         quality.min_dihedral_angle = std::min(quality.min_dihedral_angle, angle);
+         quality.max_dihedral_angle = std::max(quality.max_dihedral_angle, angle);
+      }
+   }
+
+   const double volume = std::abs(quality.volume);
+   if ( volume > 0 and area > 0 )
+   {
+      const double inradius = 3.0*volume/area;
+      Vec center = cross(b,c);
+      Vec ca = cross(c,a);
+      Vec ab = cross(a,b);
+      for ( int i = 0; i < 3; ++i )
+         center[i] = (dot(a,a)*center[i] + dot(b,b)*ca[i] + dot(c,c)*ab[i])/(2.0*det);
+      const double circumradius = norm(center);
+      quality.radius_ratio = 3.0*inradius/circumradius;
+      quality.aspect_ratio = max_edge/(2.0*std::sqrt(6.0)*inradius);
+   }
+   else
+   {
+      quality.radius_ratio = 0.0;
+      quality.aspect_ratio = std::numeric_limits<double>::infinity();
+   }
+   return quality;
+}
+
+/**
+ * \class
+ *
+ * @brief Quality metrics of all cells in a mesh, with histograms and percentiles
+ * for each subdomain and the worst cells of each metric.
+ *
+ * The cells are indexed in the order of the cells in the complex, which is the
+ * order of the tetrahedra written by Domain::save and Domain::export_mesh.
+ * The report is not copyable, since set writes through pointers to its own arrays.
+ */
+class Quality_report
+{
+   public:
+        Quality_report() {}
+        Quality_report(const Quality_report&) = delete;
+        Quality_report& operator=(const Quality_report&) = delete;
+
+        /**
+         * @brief Returns the names of the metrics.
+         * @param none
+         * @return names of the metrics.
+         */
+        static const std::vector<std::string>& metric_names()
+        {
+           static const std::vector<std::string> names = {"min_dihedral_angle", "max_dihedral_angle",
+                                                          "radius_ratio", "edge_ratio", "volume", "aspect_ratio"};
+           return names;
+        }
+
+        /**
+         * @brief Returns true if low values of a metric indicate poor quality.
+         * @param name the name of the metric.
+         * @return true if low values are worse.
+         */
+        static bool low_is_worse(const std::string& name)
+        {
+           return name == "min_dihedral_angle" or name == "radius_ratio" or name == "volume";
+        }
+
+        /**
+         * @brief Allocates the metric arrays for a number of cells.
+         * @param number_of_cells the number of cells.
+         * @return void
+         */
+        void resize(std::size_t number_of_cells)
+        {
+           subdomains.assign(number_of_cells, 0);
+           for ( std::size_t k = 0; k < metric_names().size(); ++k )
+           {
+              std::vector<double>& column = values[metric_names()[k]];
+              column.assign(number_of_cells, 0.0);
+              columns[k] = column.data();
+           }
+        }
+
+        /**
+         * @brief Stores the metrics of a cell, and can be called concurrently for different cells.
+         * @param i the cell index.
+         * @param subdomain the subdomain tag of the cell.
+         * @param quality the metrics of the cell.
+         * @return void
+         */
+        void set(std::size_t i, int subdomain, const Tetrahedron_quality& quality)
+        {
+           subdomains[i] = subdomain;
+           columns[0][i] = quality.min_dihedral_angle;
+           columns[1][i] = quality.max_dihedral_angle;
+           columns[2][i] = quality.radius_ratio;
+           columns[3][i] = quality.edge_ratio;
+           columns[4][i] = quality.volume;
+           columns[5][i] = quality.aspect_ratio;
+        }
+
+        /**
+         * @brief Computes the histograms and percentiles for each subdomain and metric,
+         * and the worst cells for each metric. The histograms have equal bins between
+         * the finite minimum and maximum of the metric over all cells, and infinite 
+         * values, i.e. from degenerate cells, are counted in the first or last bin.
+         * @param number_of_bins the number of bins in the histograms.
+         * @param percentiles the percentiles in [0,100] to compute.
+         * @param number_of_worst_cells the number of worst cells to store for each metric.
+         * @return void
+         * @throws InvalidArgumentError if the number of bins is less than 1, or a percentile is outside [0,100].
+         */
+        void compute_statistics(int number_of_bins, const std::vector<double>& percentiles, std::size_t number_of_worst_cells)
+        {
+           if ( number_of_bins < 1 )
+              throw InvalidArgumentError("Number of bins must be positive.");
+           for ( double q : percentiles )
+           {
+              if ( q < 0 or q > 100 )
+                 throw InvalidArgumentError("Percentiles must be between 0 and 100.");
+           }
+           this->percentiles = percentiles;
+
+           std::map<int,std::vector<std::size_t>> cells;
+           for ( std::size_t i = 0; i < subdomains.size(); ++i )
+              cells[subdomains[i]].push_back(i);
+
+           const std::vector<std::string>& names = metric_names();
+           std::vector<std::pair<std::string,int>> groups;
+           for ( auto& name : names )
+           {
+              const std::vector<double>& v = values.at(name);
+              double lo = std::numeric_limits<double>::max();
+              double hi = std::numeric_limits<double>::lowest();
+              for ( double x : v )
+              {
+                 if ( std::isfinite(x) ) { lo = std::min(lo, x); hi = std::max(hi, x); }
+              }
+              if ( lo > hi ) { lo = 0.0; hi = 0.0; }
+              std::vector<double>& edges = histogram_edges[name];
+              edges.resize(number_of_bins + 1);
+              for ( int b = 0; b <= number_of_bins; ++b )
+                 edges[b] = lo + (hi - lo)*b/number_of_bins;
+              for ( auto& it : cells )
+              {
+                 histograms[name][it.first];
+                 percentile_values[name][it.first];
+                 groups.push_back(std::make_pair(name, it.first));
+              }
+              worst_cells[name];
+           }
+
+           parallel_for_each_index(groups.size() + names.size(), [&](std::size_t g)
+           {
+              if ( g >= groups.size() )
+              {
+                 const std::string& name = names[g - groups.size()];
+                 worst_cells.at(name) = find_worst_cells(values.at(name), low_is_worse(name), number_of_worst_cells);
+                 return;
+              }
+              const std::string& name = groups[g].first;
+              const std::vector<double>& v = values.at(name);
+              const std::vector<double>& edges = histogram_edges.at(name);
+              const std::vector<std::size_t>& group = cells.at(groups[g].second);
+
+              std::vector<double> sorted;
+              sorted.reserve(group.size());
+              std::vector<std::size_t> histogram(number_of_bins, 0);
+              const double lo = edges.front();
+              const double width = edges.back() - edges.front();
+              for ( std::size_t i : group )
+              {
+                 if ( std::isnan(v[i]) )
+                    continue;
+                 sorted.push_back(v[i]);
+                 int b = 0;
+                 if ( std::isinf(v[i]) )
+                    b = v[i] > 0 ? number_of_bins - 1 : 0;
+                 else if ( width > 0 )
+                    b = std::min(number_of_bins - 1, static_cast<int>((v[i] - lo)/width*number_of_bins));
+                 histogram[std::max(0, b)]++;
+              }
+              std::sort(sorted.begin(), sorted.end());
+              std::vector<double> result;
+              for ( double q : percentiles )
+              {
+                 if ( sorted.empty() )
+                 {
+                    result.push_back(std::numeric_limits<double>::quiet_NaN());
+                    continue;
+                 }
+                 double position = q/100.0*(sorted.size() - 1);
+                 std::size_t below = static_cast<std::size_t>(std::floor(position));
+                 std::size_t above = std::min(below + 1, sorted.size() - 1);
+                 result.push_back(sorted[below] + (position - below)*(sorted[above] - sorted[below]));
+              }
+              histograms.at(name).at(groups[g].second) = std::move(histogram);
+              percentile_values.at(name).at(groups[g].second) = std::move(result);
+           });
+        }
+
+        /**
+         * @brief Returns the metric values of all cells.
+         * @param name the name of the metric.
+         * @return values of the metric for each cell.
+         * @throws InvalidArgumentError if the metric does not exist.
+         */
+        const std::vector<double>& get_values(const std::string& name) const
+        {
+           auto it = values.find(name);
+           if ( it == values.end() )
+              throw InvalidArgumentError("Unknown quality metric.");
+           return it->second;
+        }
+
+        std::size_t number_of_cells() const { return subdomains.size(); }
+
+        std::vector<int> subdomains;
+        std::map<std::string,std::vector<double>> values;
+        std::vector<double> percentiles;
+        std::map<std::string,std::vector<double>> histogram_edges;
+        std::map<std::string,std::map<int,std::vector<std::size_t>>> histograms;
+        std::map<std::string,std::map<int,std::vector<double>>> percentile_values;
+        std::map<std::string,std::vector<std::size_t>> worst_cells;
+
+   private:
+        std::array<double*,6> columns;
+
+        static std::vector<std::size_t> find_worst_cells(const std::vector<double>& v, bool low_is_worse, std::size_t n)
+        {
+           std::vector<std::size_t> order(v.size());
+           std::iota(order.begin(), order.end(), 0);
+           n = std::min(n, order.size());
+           auto worse = [&v,low_is_worse](std::size_t i, std::size_t j)
+           {
+              if ( std::isnan(v[i]) or std::isnan(v[j]) )
+                 return std::isnan(v[i]) and !std::isnan(v[j]);
+              return low_is_worse ? v[i] < v[j] : v[i] > v[j];
+           };
+           std::partial_sort(order.begin(), order.begin() + n, order.end(), worse);
+           order.resize(n);
+           return order;
+        }
+};
+
+#endif
@@ -0,0 +1,93 @@
+// Copyright (C) 2018-2021 Lars Magnus Valnes
+//
+// This file is part of Surface Volume Meshing Toolkit (SVM-TK).
+//
+// SVM-Tk is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SVM-Tk is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SVM-Tk.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef Parallel_H
+
+#define Parallel_H
+
+/* -- STL -- */
+#include <algorithm>
+#include <cstddef>
+
+/* -- TBB -- */
+#ifdef CGAL_LINKED_WITH_TBB
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
+#include <tbb/blocked_range.h>
+#include <tbb/task_arena.h>
+#endif
+
+/**
+ * @brief Calls function(i) for i in [0,n), in parallel if SVMTK is built with TBB.
+ * The function must be safe to call concurrently for different i.
+ * @param n the number of iterations.
+ * @param function callable with a std::size_t argument.
+ * @return void
+ */
+template<typename Function>
+void parallel_for_each_index(std::size_t n, Function function)
+{
+#ifdef CGAL_LINKED_WITH_TBB
+   tbb::parallel_for(tbb::blocked_range<std::size_t>(0, n),
+                     [&function](const tbb::blocked_range<std::size_t>& range)
+                     {
+                        for ( std::size_t i = range.begin(); i != range.end(); ++i )
+                           function(i);
+                     });
+#else
+   for ( std::size_t i = 0; i < n; ++i )
+      function(i);
+#endif
+}
+
+/**
+ * @brief Sorts a range, in parallel if SVMTK is built with TBB.
+ * @param begin random access iterator to the first element.
+ * @param end random access iterator past the last element.
+ * @param compare strict weak ordering.
+ * @return void
+ */
+template<typename Iterator, typename Compare>
+void parallel_sort(Iterator begin, Iterator end, Compare compare)
+{
+#ifdef CGAL_LINKED_WITH_TBB
+   tbb::parallel_sort(begin, end, compare);
+#else
+   std::sort(begin, end, compare);
+#endif
+}
+
+/**
+ * @brief Runs a function with a limited number of threads if SVMTK is built with TBB.
+ * @param number_of_threads the maximum number of threads, 0 uses all available threads.
+ * @param function callable without arguments.
+ * @return void
+ */
+template<typename Function>
+void run_with_number_of_threads(int number_of_threads, Function function)
+{
+#ifdef CGAL_LINKED_WITH_TBB
+   if ( number_of_threads > 0 )
+   {
+      tbb::task_arena arena(number_of_threads);
+      arena.execute(function);
+      return;
+   }
+#endif
+   function();
+}
+
+#endif
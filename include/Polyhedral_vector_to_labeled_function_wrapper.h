@@ -5,10 +5,46 @@
 /* --- Includes -- */
 #include "SubdomainMap.h" 
 
+/* -- STL -- */
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
 /* -- CGAL Polygon Mesh Processing -- */
 #include <CGAL/Polygon_mesh_processing/bbox.h>
 
 
+/**
+ * \struct
+ * 
+ * @brief Counters for the calls to the subdomain labeling oracle.
+ *
+ * The counters are only updated when enabled, and are shared between 
+ * the copies of the labeling oracle made by CGAL Mesh_3. 
+ */
+struct Labeling_oracle_statistics
+{
+    std::atomic<bool> enabled{false};
+    std::atomic<std::uint64_t> calls{0};
+    std::atomic<std::uint64_t> ray_casts{0};
+    std::atomic<std::uint64_t> bbox_rejections{0};
+    std::atomic<std::uint64_t> nanoseconds{0};
+
+    /**
+     * @brief Sets all counters to zero.
+     * @param none
+     * @return void
+     */
+    void reset()
+    {
+        calls = 0;
+        ray_casts = 0;
+        bbox_rejections = 0;
+        nanoseconds = 0;
+    }
+};
+
 /*
  * 
  * CGAL Polyhedron to CGAL labeled mesh.
@@ -26,19 +62,31 @@ namespace CGAL {
                 typedef std::vector<Function_*>   Function_vector;
                 typedef typename BGT::Point_3       Point_3;
                 typedef boost::dynamic_bitset<>   Bmask;
+                typedef std::uint64_t             Fixed_mask;
                 typedef typename BGT::Sphere_3    Sphere_3;
                 
                 /**
-                 * @brief TODO
+                 * @brief Stores the surfaces, their bounding boxes and the subdomain map.
                  * 
+                 * The type of the subdomain map is resolved once, so that the label lookup 
+                 * for DefaultMap and SubdomainMap avoids the virtual call.
+                 *
                  * @param v a vector of functions i.e. surfaces with query is inside  
                  * @param map a smart pointer to a child class of SVMTK virtuell class AbstractMap
                  *       options : DefaultMap and SubdomainMap
+                 * @param statistics optional counters for the oracle calls.
                  */
-                Polyhedral_vector_to_labeled_function_wrapper(const std::vector<Function_*>& v, std::shared_ptr<AbstractMap> map) : function_vector_(v)
+                Polyhedral_vector_to_labeled_function_wrapper(const std::vector<Function_*>& v, std::shared_ptr<AbstractMap> map,
+                                                              std::shared_ptr<Labeling_oracle_statistics> statistics = nullptr) : function_vector_(v)
                 {
                     subdmap =std::move(map);
-
+                    statistics_ = std::move(statistics);
+                    default_map_ = dynamic_cast<DefaultMap*>(subdmap.get());
+                    subdomain_map_ = dynamic_cast<SubdomainMap*>(subdmap.get());
+                    for ( auto function : function_vector_ )
+                    {
+                        bboxes_.push_back(function->bbox());
+                    }
                 }
 
                 ~Polyhedral_vector_to_labeled_function_wrapper() {}
@@ -58,15 +106,16 @@ namespace CGAL {
                  */
                 return_type operator()(const Point_3& p, bool use_cache = false) const
                 {
-                    int nb_func = function_vector_.size();
-                    Bmask bits(nb_func);
-
-                    for ( int i = 0 ; i < nb_func ; ++i )
+                    if ( statistics_ and statistics_->enabled.load(std::memory_order_relaxed) )
                     {
-                        bits[i] =(bool)function_vector_[i]->is_in_domain_object()(p);
+                        auto start = std::chrono::steady_clock::now();
+                        return_type result = label(p);
+                        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+                        statistics_->calls.fetch_add(1, std::memory_order_relaxed);
+                        statistics_->nanoseconds.fetch_add(static_cast<std::uint64_t>(elapsed.count()), std::memory_order_relaxed);
+                        return result;
                     }
-
-                    return subdmap->index(bits);
+                    return label(p);
                 }
                 
                /**
@@ -76,21 +125,86 @@ namespace CGAL {
                  */
                 Bbox_3 bbox() const
                 {
-                    int nb_func = function_vector_.size();
-
                     Bbox_3 sum_bbox;
-                    for ( int i = 0 ; i < nb_func ; ++i )
+                    for ( auto& function_bbox : bboxes_ )
                     {
-                        sum_bbox+= function_vector_[i]->bbox();
+                        sum_bbox+= function_bbox;
                     }
                     return sum_bbox;
                 }
-     
-
 
             private:
+               /**
+                 * @brief Computes the subdomain tag of a point without heap allocation.
+                 * 
+                 * Uses a fixed-width mask with the DefaultMap or a frozen SubdomainMap 
+                 * for up to 64 surfaces, otherwise a bitstring that is allocated once per thread.
+                 * @param p a CGAL 3D Point object 
+                 * @return the subdomain tag of the point.
+                 */
+                return_type label(const Point_3& p) const
+                {
+                    const std::size_t nb_func = function_vector_.size();
+
+                    if ( nb_func <= 64 and ( default_map_ or ( subdomain_map_ and subdomain_map_->is_frozen() ) ) )
+                    {
+                        Fixed_mask mask = 0;
+                        for ( std::size_t i = 0 ; i < nb_func ; ++i )
+                        {
+                            if ( is_inside(i, p) )
+                                mask |= Fixed_mask(1) << i;
+                        }
+                        if ( subdomain_map_ )
+                            return subdomain_map_->SubdomainMap::index(mask);
+                        return default_map_->DefaultMap::index(mask);
+                    }
+
+                    static thread_local Bmask bits;
+                    bits.resize(nb_func);
+                    bits.reset();
+                    for ( std::size_t i = 0 ; i < nb_func ; ++i )
+                    {
+                        if ( is_inside(i, p) )
+                            bits.set(i);
+                    }
+
+                    if ( subdomain_map_ )
+                        return subdomain_map_->SubdomainMap::index(bits);
+                    if ( default_map_ )
+                        return default_map_->DefaultMap::index(bits);
+                    return subdmap->index(bits);
+                }
+
+               /**
+                 * @brief Checks if a point is inside a surface. Points outside the bounding 
+                 * box of the surface are rejected before the ray casting. 
+                 * @param i the index of the surface
+                 * @param p a CGAL 3D Point object 
+                 * @return true if the point is inside the surface.
+                 */
+                bool is_inside(std::size_t i, const Point_3& p) const
+                {
+                    const Bbox_3& box = bboxes_[i];
+                    const bool count = statistics_ and statistics_->enabled.load(std::memory_order_relaxed);
+                    if ( p.x() < box.xmin() or p.x() > box.xmax() or
+                         p.y() < box.ymin() or p.y() > box.ymax() or
+                         p.z() < box.zmin() or p.z() > box.zmax() )
+                    {
+                        if ( count )
+                           statistics_->bbox_rejections.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    if ( count )
+                        statistics_->ray_casts.fetch_add(1, std::memory_order_relaxed);
+                    return static_cast<bool>(function_vector_[i]->is_in_domain_object()(p));
+                }
+
                 Function_vector function_vector_;
+                std::vector<Bbox_3> bboxes_;
                 std::shared_ptr<AbstractMap> subdmap;
+                DefaultMap* default_map_;
+                SubdomainMap* subdomain_map_;
+                std::shared_ptr<Labeling_oracle_statistics> statistics_;
         };
 }
 
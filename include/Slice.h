@@ -208,9 +208,9 @@ class Slice
        void set_plane(Plane_3 inplane){ this->plane = inplane;}
        Plane_3& get_plane(){return this->plane;}
        template<typename Surface> 
-       void add_surface_domains(std::vector<Surface> surfaces, AbstractMap& map); 
+       void add_surface_domains(const std::vector<Surface>& surfaces, AbstractMap& map); 
        template<typename Surface> 
-       void add_surface_domains(std::vector<Surface> surfaces); 
+       void add_surface_domains(const std::vector<Surface>& surfaces); 
        template< typename Surface> 
        void slice_surfaces(std::vector<Surface> surfaces);
 
@@ -547,7 +547,7 @@ std::shared_ptr<Surface> Slice::as_surface()
  * @overload 
  */
 template<typename Surface> 
-void Slice::add_surface_domains(std::vector<Surface> surfaces)
+void Slice::add_surface_domains(const std::vector<Surface>& surfaces)
 {
    DefaultMap map =DefaultMap();
    add_surface_domains(surfaces,map);
@@ -566,7 +566,7 @@ void Slice::add_surface_domains(std::vector<Surface> surfaces)
  * @overload  
  */
 template<typename Surface> 
-void Slice::add_surface_domains(std::vector<Surface> surfaces, AbstractMap& map) 
+void Slice::add_surface_domains(const std::vector<Surface>& surfaces, AbstractMap& map) 
 {
    assert_non_empty_mesh();
    typedef boost::dynamic_bitset<>   Bmask;
@@ -577,10 +577,11 @@ void Slice::add_surface_domains(std::vector<Surface> surfaces, AbstractMap& map)
    Pid spp;
    std::map<Face_handle,Bmask> masks;
    int index_counter=1;
+   map.freeze(static_cast<int>(surfaces.size()));
    
-   for ( auto surf :  surfaces) 
+   for ( auto& surf :  surfaces) 
    {
-       typename Surface::Inside inside(surf.get_mesh());
+       const typename Surface::Inside& inside = surf.get_inside_query();
        for(CDT::Face_iterator fit = cdt.faces_begin(); fit != cdt.faces_end(); ++fit)
        {
           Point_2 p2 =  CGAL::centroid(fit->vertex(0)->point() ,fit->vertex(1)->point(),fit->vertex(2)->point());  
@@ -25,6 +25,9 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 
 /* -- boost-- */
 #include <boost/dynamic_bitset.hpp>
@@ -33,6 +36,160 @@
 
 
 
+/**
+ * \class 
+ * 
+ * Immutable lookup table from bitstrings, packed in a 64 bit integer, to tags. 
+ * 
+ * Up to dense_limit bits, the table stores a tag for all possible bitstrings. 
+ * Beyond that, the table is a perfect hash (hash and displace) of the stored 
+ * bitstrings. The lookup is O(1) and does not modify the table, so it can be 
+ * used concurrently from several threads. 
+ */
+class Frozen_label_table
+{
+   public:
+        typedef int return_type;
+        typedef std::uint64_t Key;
+
+        static const int dense_limit = 20;
+
+        Frozen_label_table() {}
+
+        /**
+         * @brief Builds the table from bitstrings and tags.
+         * @param entries vector of bitstrings and tags, the bitstrings must be unique.
+         * @param number_of_bits the number of bits in the bitstrings, at most 64.
+         * @param default_tag the tag of bitstrings that are not in entries.
+         * @return void
+         */
+        void build(const std::vector<std::pair<Key,return_type>>& entries, int number_of_bits, return_type default_tag=0)
+        {
+           this->default_tag = default_tag;
+           dense.clear();
+           keys.clear();
+           values.clear();
+           occupied.clear();
+           displacements.clear();
+           if (number_of_bits <= dense_limit)
+           {
+              dense.assign(std::size_t(1) << number_of_bits, default_tag);
+              for (auto entry : entries)
+              {
+                 if (entry.first < dense.size())
+                    dense[entry.first] = entry.second;
+              }
+           }
+           else
+              build_perfect_hash(entries);
+        }
+
+        /**
+         * @brief Returns the tag of a bitstring.
+         * @param key bitstring packed in a 64 bit integer, where bit i is surface i.
+         * @return the tag of the bitstring, or the default tag if not stored.
+         */
+        return_type index(const Key key) const
+        {
+           if (!dense.empty())
+              return key < dense.size() ? dense[key] : default_tag;
+           if (occupied.empty())
+              return default_tag;
+           std::size_t slot = hash(key, displacements[hash(key,0) % displacements.size()] + 1) % occupied.size();
+           return (occupied[slot] and keys[slot] == key) ? values[slot] : default_tag;
+        }
+
+   private:
+        static Key mix(Key x)
+        {
+           x += 0x9e3779b97f4a7c15ULL;
+           x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+           x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+           return x ^ (x >> 31);
+        }
+
+        static std::size_t hash(Key key, Key seed) { return static_cast<std::size_t>(mix(key ^ mix(seed))); }
+
+        /**
+         * @brief Builds a perfect hash with buckets of about four keys, where each bucket 
+         * stores the seed that places its keys in free slots. 
+         * @param entries vector of unique bitstrings and tags.
+         * @return void
+         */
+        void build_perfect_hash(const std::vector<std::pair<Key,return_type>>& entries)
+        {
+           if (entries.empty())
+              return;
+           const std::size_t number_of_buckets = entries.size()/4 + 1;
+           std::size_t number_of_slots = entries.size() + entries.size()/4 + 1;
+
+           std::vector<std::vector<std::size_t>> buckets(number_of_buckets);
+           for (std::size_t i = 0; i < entries.size(); ++i)
+              buckets[hash(entries[i].first, 0) % number_of_buckets].push_back(i);
+
+           std::vector<std::size_t> order(number_of_buckets);
+           for (std::size_t b = 0; b < number_of_buckets; ++b)
+              order[b] = b;
+           std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return buckets[a].size() > buckets[b].size(); });
+
+           bool success = false;
+           while (!success)
+           {
+              success = true;
+              displacements.assign(number_of_buckets, 0);
+              keys.assign(number_of_slots, 0);
+              values.assign(number_of_slots, default_tag);
+              occupied.assign(number_of_slots, 0);
+
+              for (auto b : order)
+              {
+                 if (buckets[b].empty())
+                    break;
+                 bool placed = false;
+                 std::vector<std::size_t> slots;
+                 for (Key d = 0; d < 4*number_of_slots and !placed; ++d)
+                 {
+                    slots.clear();
+                    placed = true;
+                    for (auto i : buckets[b])
+                    {
+                       std::size_t slot = hash(entries[i].first, d + 1) % number_of_slots;
+                       if (occupied[slot] or std::find(slots.begin(), slots.end(), slot) != slots.end())
+                       {
+                          placed = false;
+                          break;
+                       }
+                       slots.push_back(slot);
+                    }
+                    if (placed)
+                    {
+                       displacements[b] = d;
+                       for (std::size_t j = 0; j < slots.size(); ++j)
+                       {
+                          occupied[slots[j]] = 1;
+                          keys[slots[j]] = entries[buckets[b][j]].first;
+                          values[slots[j]] = entries[buckets[b][j]].second;
+                       }
+                    }
+                 }
+                 if (!placed)
+                 {
+                    success = false;
+                    number_of_slots *= 2;
+                    break;
+                 }
+              }
+           }
+        }
+
+        return_type default_tag = 0;
+        std::vector<return_type> dense;
+        std::vector<Key> displacements;
+        std::vector<Key> keys;
+        std::vector<return_type> values;
+        std::vector<char> occupied;
+};
+
 /**
  * \class 
  * The Abstract superclass for SubdomainMap.
@@ -43,8 +200,17 @@ class AbstractMap
         typedef int return_type;
         typedef boost::dynamic_bitset<> Bmask;
         
-        virtual return_type index(const Bmask bits) = 0;
+        virtual return_type index(const Bmask& bits) const = 0;
         virtual const std::map<std::pair<int,int>,int> make_interfaces(std::vector<std::pair<int,int>> interfaces)=0;
+
+        /**
+         * @brief Prepares the map for concurrent lookups before meshing. 
+         * After this call, index must not modify the map.
+         * @param number_of_surfaces the number of surfaces, i.e. bits, used in the lookups.
+         * @return void
+         */
+        virtual void freeze(int number_of_surfaces) {}
+
         AbstractMap() {}
         virtual ~AbstractMap() {}
 
@@ -68,12 +234,47 @@ class DefaultMap : virtual public AbstractMap
         /** 
          * @brief Maps bistring to an integer using binary conversion to integer
          * @param bits a bitstring of the form boost::dynamic_bitset.
-         * @return long conversion of the bit string.
+         * @return integer conversion of the bit string.
+         * @throws InvalidArgumentError if a set bit does not fit in the integer tag.
+         */
+        return_type index(const Bmask& bits) const
+        {
+           std::uint64_t mask = 0;
+           for (auto i = bits.find_first(); i != Bmask::npos; i = bits.find_next(i))
+           {
+              if (i >= max_surfaces)
+                 throw InvalidArgumentError("DefaultMap supports at most 31 surfaces, use SubdomainMap.");
+              mask |= std::uint64_t(1) << i;
+           }
+           return static_cast<return_type>(mask);
+        }
+
+        /** 
+         * @brief Maps a bitstring packed in an integer to an integer tag.
+         * @param mask bitstring where bit i is surface i.
+         * @return integer conversion of the bit string.
+         */
+        return_type index(const std::uint64_t mask) const
+        {
+           return static_cast<return_type>(mask);
+        }
+
+        /** 
+         * @brief The DefaultMap is stateless, and is always ready for concurrent lookups.
+         * Checks that all tags fit in the integer tag type.
+         * @param number_of_surfaces the number of surfaces used in the lookups.
+         * @return void 
+         * @throws InvalidArgumentError if the number of surfaces is larger than 31.
          */
-        return_type index(const Bmask bits) 
+        void freeze(int number_of_surfaces) 
         {
-           return static_cast<return_type>(bits.to_ulong());
+           if (number_of_surfaces > static_cast<int>(max_surfaces))
+              throw InvalidArgumentError("DefaultMap supports at most 31 surfaces, use SubdomainMap.");
         }
+
+        /** The maximum number of surfaces, such that the binary conversion fits in return_type. */
+        static const std::size_t max_surfaces = 31;
+
         struct sort_pairs{
                   template<typename T>
                   bool operator()(const std::vector<T> & a, const std::vector<T> & b)
@@ -104,31 +305,16 @@ class DefaultMap : virtual public AbstractMap
         }
 };
 
-/**
- * @brief Creates all possible binarystring given the number of elements elements
- * @param[in] string unfinished binarystirng, i.e. elements < max_elements 
- * @param[out] strings contains all possible binarystirng given the number of elements in binary string.
- * @param[in] max_elements number of elements in bitstring
- * @return void.
- */
-inline 
-void generate_binary_strings(std::string string, std::vector<std::string>& strings, int max_elements) 
-{
-    if( static_cast<int>(string.length())<max_elements)
-    {
-       generate_binary_strings(string+"0", strings, max_elements); 
-       generate_binary_strings(string+"1", strings, max_elements); 
-    }
-    else if ( static_cast<int>(string.length())==max_elements) 
-    {
-       strings.push_back(string);
-    }    
-    return;
-}
 /**
  * \class
  *
  *  User specific method to set subdomains in the mesh.
+ *
+ *  The map consists of bitstrings and wildcard rules. A wildcard rule 
+ *  is stored as the bits that must be one and the bits that must be zero, 
+ *  and the remaining bits are free. If several bitstrings or rules match, 
+ *  the first added is used, i.e. the same result as if every wildcard 
+ *  were expanded to all possible bitstrings when it was added.  
  */
 class SubdomainMap :virtual public AbstractMap
 {
@@ -162,16 +348,17 @@ class SubdomainMap :virtual public AbstractMap
             if (number_of_surfaces<1)
                throw InvalidArgumentError("Invalid number of surfaces"); 
             this->num_surfaces= number_of_surfaces;
+            this->frozen = false;
             std::string zero_tag = std::string(number_of_surfaces , '0');
             add(zero_tag,0);
         }
 
         /**
-         * @brief Automatically fills the binary combintation of a string
+         * @brief Adds a wildcard rule that matches the binary combintations of a string
          * with asterix *.
          * 
          * Precondition is that the number of surfaces is set to be non-zero.
-         * Fils the remaining binary possibilites given a substring with asterix:  
+         * Matches the remaining binary possibilites given a substring with asterix:  
          * i.e. 2 surfaces and *1 -> 01 and 11 
          *      3 surfaces and 11* -> 110 and 111 
          * The binary string containing only zero is set to zero in all cases. 
@@ -183,21 +370,22 @@ class SubdomainMap :virtual public AbstractMap
          */
         void fill(std::string istring, int pos, int tag)
         {
-             std::vector<std::string>  strings; 
-             std::string dummy;
-             generate_binary_strings(dummy, strings, this->num_surfaces - static_cast<int>(istring.length())  );  
-             
-             for ( auto i : strings)
-             {   
-                if (pos==0)
-                { 
-                   this->add(i+istring,tag); 
-                }
+             const std::size_t length = istring.length();
+             const std::size_t offset = (pos==0) ? this->num_surfaces - length : 0;
+             Rule rule;
+             rule.ones.resize(this->num_surfaces);
+             rule.zeros.resize(this->num_surfaces);
+             for ( std::size_t i = 0; i < length; ++i)
+             { 
+                if (istring[i]=='1')
+                   rule.ones.set(offset + i);
                 else 
-                {  
-                   this->add(istring+i,tag); 
-                }
+                   rule.zeros.set(offset + i);
              }
+             rule.tag = tag;
+             rule.priority = next_priority++;
+             rules.push_back(rule);
+             this->frozen = false;
         }
 
         /**
@@ -218,12 +406,6 @@ class SubdomainMap :virtual public AbstractMap
            
               int pos = static_cast<int>(string.find("*"));
               string.erase(pos,1);
-               // TODO better code writing 
-              /*if (pos==0)
-
-               else
-                  string.erase(pos);
-                */    
               if( static_cast<int>( string.length())<this->num_surfaces)
               {                                            
                   fill(string,pos,subdomain); 
@@ -236,8 +418,14 @@ class SubdomainMap :virtual public AbstractMap
               if(static_cast<int>( string.length())==this->num_surfaces or this->num_surfaces==0) 
               { 
                  std::reverse( string.begin(), string.end());
-                 if (subdmap.find(Bmask(string)) == subdmap.end() )
-                     subdmap[Bmask(string)]=subdomain;   
+                 Entry& entry = subdmap[Bmask(string)];
+                 if ( entry.erased )
+                 {
+                    entry.tag = subdomain;
+                    entry.priority = next_priority++;
+                    entry.erased = false;
+                 }
+                 this->frozen = false;
               }
               else 
                 throw InvalidArgumentError( "Use the correct number of characters in bitstring." ); 
@@ -245,6 +433,8 @@ class SubdomainMap :virtual public AbstractMap
         }      
         /**
          * @brief Erase binary string from SubdomainMap 
+         * 
+         * Wildcard rules added before the erase do not match the erased string.
          * @param string a bitstring to remove from SubdomainMap 
          * @return void
          */
@@ -252,7 +442,10 @@ class SubdomainMap :virtual public AbstractMap
         {
            // reverse the string since boost dyamic bitset reads the string in reverse
            std::reverse( string.begin(), string.end());
-           subdmap.erase(Bmask(string));
+           Entry& entry = subdmap[Bmask(string)];
+           entry.erased = true;
+           entry.cut = next_priority++;
+           this->frozen = false;
         }
         /** 
          * @brief Checks wether a point is inside a series of surfaces and returns 
@@ -262,25 +455,125 @@ class SubdomainMap :virtual public AbstractMap
          * @param bits a bitstring of the form boost::dynamic_bitset.
          * @return return_type integer determined by a map with Bmask keys.
          */
-        return_type index(const Bmask bits) 
+        return_type index(const Bmask& bits) const
+        {
+           if ( frozen and static_cast<int>(bits.size()) == frozen_bits )
+              return index(to_mask(bits));
+           return resolve(bits).first;
+        }
+
+        /** 
+         * @brief Same as index for a bitstring, but with the bitstring packed 
+         * in an integer. This avoids the bitstring if the map is frozen.
+         * @param mask bitstring where bit i is surface i.
+         * @return return_type integer determined by a map with Bmask keys.
+         */
+        return_type index(const std::uint64_t mask) const
+        {
+           if ( frozen )
+           {
+              if ( frozen_rules.empty() and frozen_entries.empty() )
+                 return table.index(mask);
+              return resolve(mask);
+           }
+           static thread_local Bmask bits;
+           bits.resize(frozen_bits > 0 ? frozen_bits : num_surfaces);
+           bits.reset();
+           for (std::size_t i = 0; i < bits.size(); ++i)
+              bits[i] = (mask >> i) & 1;
+           return index(bits);
+        }
+
+        /** 
+         * @brief Compiles the map to an immutable table, so that index is O(1) and 
+         * can be called concurrently. The map is unfrozen if it is changed.
+         *
+         * Up to Frozen_label_table::dense_limit surfaces, all bitstrings are resolved 
+         * to a dense table. Beyond that, the added bitstrings are stored in a perfect 
+         * hash, and the wildcard rules are checked at lookup.
+         * @note Maps with more than 64 surfaces are not compiled, and the lookup 
+         *       uses the ordered map without modifying it.
+         * @param number_of_surfaces the number of surfaces used in the lookups. 
+         * @return void
+         */
+        void freeze(int number_of_surfaces)
         {
-           return static_cast<return_type>(subdmap[bits]);  
+           int number_of_bits = std::max(number_of_surfaces, num_surfaces);
+           if ( frozen and number_of_bits == frozen_bits )
+              return;
+           frozen = false;
+           frozen_bits = number_of_bits;
+           frozen_entries.clear();
+           frozen_rules.clear();
+           if ( number_of_bits > 64 )
+              return;
+
+           std::vector<std::pair<Frozen_label_table::Key,return_type>> entries;
+           std::vector<Fixed_rule> fixed_rules;
+           for (auto& rule : rules)
+           {
+              if ( static_cast<int>(rule.ones.size()) == number_of_bits )
+                 fixed_rules.push_back(Fixed_rule{to_mask(rule.ones), to_mask(rule.zeros), rule.tag, rule.priority});
+           }
+           for (auto& it : subdmap)
+           {
+              if ( static_cast<int>(it.first.size()) != number_of_bits )
+                 continue;
+              entries.push_back(std::make_pair(to_mask(it.first), static_cast<return_type>(frozen_entries.size())));
+              frozen_entries.push_back(it.second);
+           }
+
+           if ( number_of_bits <= Frozen_label_table::dense_limit )
+           {
+              Frozen_label_table lookup;
+              lookup.build(entries, number_of_bits, -1);
+              frozen_rules = fixed_rules;
+              std::vector<std::pair<Frozen_label_table::Key,return_type>> resolved;
+              for (std::uint64_t mask = 0; mask < (std::uint64_t(1) << number_of_bits); ++mask)
+              {
+                 return_type tag = resolve(mask, lookup.index(mask));
+                 if (tag != 0)
+                    resolved.push_back(std::make_pair(mask, tag));
+              }
+              frozen_rules.clear();
+              frozen_entries.clear();
+              table.build(resolved, number_of_bits, 0);
+           }
+           else 
+           {
+              table.build(entries, number_of_bits, -1);
+              frozen_rules = fixed_rules;
+           }
+           frozen = true;
         }
+
+        /** 
+         * @brief Returns true if the map is compiled to an immutable table.
+         * @param none
+         * @return true if frozen.
+         */
+        bool is_frozen() const { return frozen; }
+
         /** 
          * @brief Prints Subdomains and Patches
+         * @note Wildcard rules with more than expand_limit free bits are printed 
+         *       with * for the free bits, @see get_map.
          * @param none 
          * @return void
          *
          */
         void print() 
         {
-           for(std::map<boost::dynamic_bitset<>,int>::iterator it=subdmap.begin();it!=subdmap.end();++it )
+           std::vector<const Rule*> unexpanded;
+           for ( auto it : expand(unexpanded) )
            {
               // Reversed so to look like what was added
-              std::string dummy = boost::lexical_cast<std::string>(it->first);
+              std::string dummy = boost::lexical_cast<std::string>(it.first);
               std::reverse(dummy.begin(),dummy.end());
-              std::cout<< "Subdomain: " << dummy << " " << it->second << " " << std::endl;
+              std::cout<< "Subdomain: " << dummy << " " << it.second << " " << std::endl;
            }
+           for ( auto rule : unexpanded )
+              std::cout<< "Subdomain: " << to_string(*rule) << " " << rule->tag << " " << std::endl;
            for(std::map<std::pair<int,int>,int>::iterator it=patches.begin();it!=patches.end();++it )
            {
               std::cout<< "Patches: " << it->first.first << " " << it->first.second << " " << it->second << " " << std::endl;
@@ -289,37 +582,50 @@ class SubdomainMap :virtual public AbstractMap
         }
         /** 
          * @brief Returns all tags that is added to the class object.  
+         * @note Wildcard rules with more than expand_limit free bits give one tag, @see get_map.
          * @param none 
          * @return tags vector of integer that represents the tags added to the class object.
          */
         std::vector<int> get_tags() 
         {
               std::vector<int> tags;
-              for (auto it : subdmap) 
+              std::vector<const Rule*> unexpanded;
+              for (auto it : expand(unexpanded)) 
               {
                  tags.push_back(it.second);
               } 
+              for (auto rule : unexpanded) 
+                 tags.push_back(rule->tag);
               return tags;
         }
         
         /** 
          * @brief Returns the map. 
+         * @note Wildcard rules are expanded to all matching bitstrings if they have at most 
+         *       expand_limit free bits. Otherwise the rule is given as a bitstring with * 
+         *       for the free bits, i.e. 30 surfaces and 1* -> 1 followed by 29 *.
          * @param none 
-         * @return tags vector of integer that represents the tags added to the class object.
+         * @return map of bitstrings, and wildcard strings, with the corresponding tags.
          */
         std::map<std::string,int> get_map() 
         {
            std::map<std::string,int> result; 
-           for(std::map<boost::dynamic_bitset<>,int>::iterator it=subdmap.begin();it!=subdmap.end();++it )
+           std::vector<const Rule*> unexpanded;
+           for ( auto it : expand(unexpanded) )
            {
               // Reversed so to look like what was added
-              std::string dummy = boost::lexical_cast<std::string>(it->first);
+              std::string dummy = boost::lexical_cast<std::string>(it.first);
               std::reverse(dummy.begin(),dummy.end());
-              result[dummy] = it->second;
+              result[dummy] = it.second;
            }  
+           for ( auto rule : unexpanded )
+              result.emplace(to_string(*rule), rule->tag);
            return result;  
         }
 
+        /** The largest number of free bits of a wildcard rule that is expanded by get_map, get_tags and print. */
+        static const int expand_limit = 20;
+
         /**
          * @brief Adds a tag value for surfaces patches between subdomains defined by a pair of integer 
          * the class member variable patches 
@@ -386,8 +692,183 @@ class SubdomainMap :virtual public AbstractMap
         }
 
    private:
+        /** Added bitstring, where erased bitstrings ignore the rules added before cut. */
+        struct Entry
+        {
+           return_type tag = 0;
+           std::size_t priority = 0;
+           std::size_t cut = 0;
+           bool erased = true;
+        };
+
+        /** Wildcard rule with the bits that must be one or zero. */
+        struct Rule
+        {
+           Bmask ones;
+           Bmask zeros;
+           return_type tag;
+           std::size_t priority;
+        };
+
+        /** Wildcard rule with bits packed in 64 bit integers. */
+        struct Fixed_rule
+        {
+           std::uint64_t ones;
+           std::uint64_t zeros;
+           return_type tag;
+           std::size_t priority;
+        };
+
+        static std::uint64_t to_mask(const Bmask& bits)
+        {
+           std::uint64_t mask = 0;
+           for (auto i = bits.find_first(); i != Bmask::npos; i = bits.find_next(i))
+              mask |= std::uint64_t(1) << i;
+           return mask;
+        }
+
+        /**
+         * @brief Finds the first added bitstring or rule that matches a bitstring.
+         * @param bits a bitstring of the form boost::dynamic_bitset.
+         * @return pair of the tag and true if found, or 0 and false if not. 
+         */
+        std::pair<return_type,bool> resolve(const Bmask& bits) const
+        {
+           std::size_t best = std::numeric_limits<std::size_t>::max();
+           std::size_t cut = 0;
+           bool has_cut = false;
+           std::pair<return_type,bool> result(0,false);
+           auto it = subdmap.find(bits);
+           if ( it != subdmap.end() )
+           {
+              if ( !it->second.erased )
+              {
+                 best = it->second.priority;
+                 result = std::make_pair(it->second.tag,true);
+              }
+              cut = it->second.cut;
+              has_cut = it->second.cut > 0 or it->second.erased;
+           }
+           for ( auto& rule : rules )
+           {
+              if ( rule.priority >= best )
+                 break;
+              if ( has_cut and rule.priority < cut )
+                 continue;
+              if ( rule.ones.size() == bits.size() and rule.ones.is_subset_of(bits) and !rule.zeros.intersects(bits) )
+                 return std::make_pair(rule.tag,true);
+           }
+           return result;
+        }
+
+        /**
+         * @brief Same as resolve for a bitstring, but on the frozen rules and 
+         * bitstrings packed in 64 bit integers.
+         * @param mask bitstring where bit i is surface i.
+         * @param entry index of the added bitstring in frozen_entries, or -1. 
+         * @return the tag of the bitstring.
+         */
+        return_type resolve(const std::uint64_t mask, return_type entry) const
+        {
+           std::size_t best = std::numeric_limits<std::size_t>::max();
+           std::size_t cut = 0;
+           bool has_cut = false;
+           return_type result = 0;
+           if ( entry >= 0 )
+           {
+              const Entry& e = frozen_entries[entry];
+              if ( !e.erased )
+              {
+                 best = e.priority;
+                 result = e.tag;
+              }
+              cut = e.cut;
+              has_cut = e.cut > 0 or e.erased;
+           }
+           for ( auto& rule : frozen_rules )
+           {
+              if ( rule.priority >= best )
+                 break;
+              if ( has_cut and rule.priority < cut )
+                 continue;
+              if ( (mask & rule.ones) == rule.ones and (mask & rule.zeros) == 0 )
+                 return rule.tag;
+           }
+           return result;
+        }
+
+        return_type resolve(const std::uint64_t mask) const { return resolve(mask, table.index(mask)); }
+
+        /**
+         * @brief Expands the bitstrings and the wildcard rules with at most expand_limit 
+         * free bits to a map of all matching bitstrings.
+         * @param[out] unexpanded the wildcard rules with more than expand_limit free bits.
+         * @return map of bitstrings and tags, without the erased bitstrings. 
+         */
+        std::map<Bmask,return_type> expand(std::vector<const Rule*>& unexpanded) const
+        {
+           std::map<Bmask,return_type> result;
+           for ( auto& it : subdmap )
+           {
+              auto tag = resolve(it.first);
+              if ( tag.second )
+                 result[it.first] = tag.first;
+           }
+           for ( auto& rule : rules )
+           {
+              std::vector<std::size_t> free;
+              for ( std::size_t i = 0; i < rule.ones.size(); ++i )
+              {
+                 if ( !rule.ones[i] and !rule.zeros[i] )
+                    free.push_back(i);
+              }
+              if ( static_cast<int>(free.size()) > expand_limit )
+              {
+                 unexpanded.push_back(&rule);
+                 continue;
+              }
+              Bmask bits(rule.ones);
+              for ( std::uint64_t combination = 0; combination < (std::uint64_t(1) << free.size()); ++combination )
+              {
+                 for ( std::size_t j = 0; j < free.size(); ++j )
+                    bits[free[j]] = (combination >> j) & 1;
+                 if ( result.find(bits) != result.end() )
+                    continue;
+                 auto tag = resolve(bits);
+                 if ( tag.second )
+                    result[bits] = tag.first;
+              }
+           }
+           return result;
+        }
+
+        /**
+         * @brief Writes a wildcard rule as it was added, with * for every free bit.
+         * @param rule a wildcard rule.
+         * @return string of 0, 1 and *.
+         */
+        static std::string to_string(const Rule& rule)
+        {
+           std::string string(rule.ones.size(), '*');
+           for ( std::size_t i = 0; i < rule.ones.size(); ++i )
+           {
+              if ( rule.ones[i] )
+                 string[i] = '1';
+              else if ( rule.zeros[i] )
+                 string[i] = '0';
+           }
+           return string;
+        }
+
         int num_surfaces; 
-        std::map<boost::dynamic_bitset<>,int> subdmap;
+        std::map<Bmask,Entry> subdmap;
+        std::vector<Rule> rules;
+        std::size_t next_priority = 0;
+        bool frozen = false;
+        int frozen_bits = 0;
+        Frozen_label_table table;
+        std::vector<Entry> frozen_entries;
+        std::vector<Fixed_rule> frozen_rules;
    protected:
         std::map<std::pair<int,int> ,int> patches;
 };
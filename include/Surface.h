@@ -28,6 +28,7 @@
 /* --Includes -- */
 #include "surface_mesher.h"
 #include "Errors.h"
+#include "Parallel.h"
 
 /* -- boost-- */
 #include <boost/foreach.hpp>
@@ -48,6 +49,7 @@
 #include <CGAL/Search_traits_3.h>
 #include <CGAL/Search_traits_adapter.h>
 #include <CGAL/Orthogonal_k_neighbor_search.h>
+#include <CGAL/Fuzzy_sphere.h>
 
 /* -- CGAL Triangulated Surface Mesh Shortest Paths-- */
 #include <CGAL/Surface_mesh_shortest_path.h>
@@ -97,6 +99,16 @@
 //#include <CGAL/boost/graph/split_graph_into_polylines.h>
 //#include <sys/stat.h>
 
+/* -- STL -- */
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+
 // FIXME INLUCDE @throws
 
 /**
@@ -186,6 +198,51 @@ bool load_surface(const std::string file, Mesh& mesh)
   return true;
 }
 
+/**
+ * @brief Writes a scalar volume on a regular grid to a raw or NRRD file.
+ *
+ * The values are ordered with x fastest and z slowest. A raw file holds only the 
+ * values, while a NRRD file has a header with the grid dimensions, origin and spacing
+ * followed by the raw values.
+ * @param path the path to the file with extension nrrd or raw.
+ * @param values the volume values.
+ * @param dimensions the number of grid points in each direction.
+ * @param origin the coordinates of the first grid point.
+ * @param spacing the grid spacing in each direction.
+ * @return void
+ * @throws InvalidArgumentError if the extension is unknown or the file cannot be written.
+ */
+inline void write_volume(const std::string& path, const float* values, const std::array<int,3>& dimensions,
+                         const std::array<double,3>& origin, const std::array<double,3>& spacing)
+{
+  std::string extension = path.substr(path.find_last_of(".") + 1);
+  if ( extension != "nrrd" and extension != "raw" )
+     throw InvalidArgumentError("Volume files must have extension nrrd or raw.");
+
+  std::ofstream output(path, std::ios::binary);
+  if ( !output )
+     throw InvalidArgumentError("Could not open volume file for writing.");
+  if ( extension == "nrrd" )
+  {
+     const std::uint16_t one = 1;
+     const bool little_endian = *reinterpret_cast<const unsigned char*>(&one) == 1;
+     output << "NRRD0004\n"
+            << "type: float\n"
+            << "dimension: 3\n"
+            << "space dimension: 3\n"
+            << "sizes: " << dimensions[0] << " " << dimensions[1] << " " << dimensions[2] << "\n"
+            << "space directions: (" << spacing[0] << ",0,0) (0," << spacing[1] << ",0) (0,0," << spacing[2] << ")\n"
+            << "space origin: (" << origin[0] << "," << origin[1] << "," << origin[2] << ")\n"
+            << "kinds: domain domain domain\n"
+            << "endian: " << ( little_endian ? "little" : "big" ) << "\n"
+            << "encoding: raw\n\n";
+  }
+  const std::size_t size = static_cast<std::size_t>(dimensions[0])*dimensions[1]*dimensions[2];
+  output.write(reinterpret_cast<const char*>(values), size*sizeof(float));
+  if ( !output )
+     throw InvalidArgumentError("Failed to write volume file.");
+}
+
 /** 
  * @brief Constructs a convex hull from a vector of points
  *
@@ -674,6 +731,7 @@ class Surface
     //TODO: Rename?
     typedef std::map<vertex_descriptor,Vector_3> vertex_vector_map;
     typedef std::map<vertex_descriptor,double> vertex_scalar_map;     
+    typedef std::map<std::string, double> Parameters;
        
     typedef CGAL::Search_traits_3<Kernel>                                                Traits_base;
     typedef CGAL::Search_traits_adapter<vertex_descriptor,Vertex_point_pmap,Traits_base> Traits;
@@ -681,6 +739,11 @@ class Surface
     typedef K_neighbor_search::Tree                                                      Tree;
     typedef Tree::Splitter                                                               Splitter;
     typedef K_neighbor_search::Distance                                                  Distance;
+    typedef CGAL::Fuzzy_sphere<Traits>                                                   Fuzzy_sphere;
+
+    typedef CGAL::AABB_face_graph_triangle_primitive<Mesh>                               Face_primitive;
+    typedef CGAL::AABB_traits<Kernel, Face_primitive>                                    Face_traits;
+    typedef CGAL::AABB_tree<Face_traits>                                                 Face_tree;
 
     /* -- Constructors -- */
 
@@ -689,11 +752,28 @@ class Surface
     Surface(std::vector<Point_3>& points,std::vector<Face>& faces ); 
     Surface(const std::string  filename);
     Surface(const Surface &other) {this->mesh=other.mesh; } 
-    Surface(const std::shared_ptr<Surface> surf) {this->mesh=surf.get()->get_mesh(); } 
+    Surface(const std::shared_ptr<Surface> surf) {this->mesh=surf->mesh; } 
     ~Surface(){}
     
-    Surface &operator=(Surface &other){ this->mesh= other.mesh; return *this; }
+    Surface &operator=(Surface &other){ this->mesh= other.mesh; invalidate_caches(); return *this; }
     bool is_point_inside(Point_3 point_3);
+    void is_point_inside(const double* coordinates, std::size_t number_of_points, bool* inside);
+
+    const Inside& get_inside_query() const;
+    const Tree& get_vertex_tree() const;
+    const Face_tree& get_face_tree() const;
+
+    /**
+     * @brief Discards the cached search structures of the surface mesh.
+     * Called by every function that changes the surface mesh.
+     * @param none
+     * @return void
+     */
+    void invalidate_caches() 
+    { 
+       std::lock_guard<std::mutex> lock(cache_mutex);
+       inside_query.reset(); vertex_tree.reset(); face_tree.reset(); 
+    }
 
 
     void make_cone_(    double x0, double y0, double  z0,  double x1, double y1, double z1, double r0, double edge_length) ;
@@ -738,8 +818,14 @@ class Surface
     bool surface_difference(Surface other);
     bool surface_union(Surface other);
 
-    Mesh& get_mesh() {return mesh;}
-    void clear(){ mesh.clear();}
+    /**
+     * @brief Returns the surface mesh for modification, and therefore discards the cached search structures.
+     * @param none
+     * @return the surface mesh. 
+     */
+    Mesh& get_mesh() {invalidate_caches(); return mesh;}
+    const Mesh& get_mesh() const {return mesh;}
+    void clear(){ mesh.clear(); invalidate_caches();}
 
     int num_faces()    const {return mesh.number_of_faces();}
     int num_edges()    const {return mesh.number_of_edges();}
@@ -837,10 +923,14 @@ class Surface
     void set_outward_face_orientation();
  
     std::shared_ptr<Surface> cylindric_extension(const Point_3& p1,double radius, double length, double edge_length ,bool normal=true );      
-    std::shared_ptr<Surface> cylindric_connection(Surface other, double radius, double edge_length);              
+    std::shared_ptr<Surface> cylindric_connection(const Surface& other, double radius, double edge_length);              
                    
     vertex_vector get_closest_vertices(Point_3 p1, int num = 8);
     point_vector  get_closest_points(Point_3 p1, int num=8);
+    void get_closest_vertices(const double* coordinates, std::size_t number_of_points, int k,
+                              std::int64_t* indices, double* distances) const;
+    void get_vertices_within_radius(const double* coordinates, std::size_t number_of_points, double radius,
+                                    std::vector<std::int64_t>& offsets, std::vector<std::int64_t>& indices) const;
  
     int keep_largest_connected_component();
     
@@ -848,10 +938,18 @@ class Surface
     double volume(){return CGAL::to_double(CGAL::Polygon_mesh_processing::volume(mesh));}
     double area(){return CGAL::to_double(CGAL::Polygon_mesh_processing::area(mesh));}
     double distance_to_point(Surface::Point_3 point);
+    double signed_distance_to_point(Surface::Point_3 point);
+    void distance_to_points(const double* coordinates, std::size_t number_of_points, bool use_sign, double* distances,
+                            double* closest_points = nullptr, std::int64_t* closest_faces = nullptr) const;
+    void signed_distance_field(const std::array<double,3>& origin, const std::array<double,3>& spacing,
+                               const std::array<int,3>& dimensions, float* values, bool occupancy = false) const;
+    void save_signed_distance_field(const std::string& path, const std::array<double,3>& origin, const std::array<double,3>& spacing,
+                                    const std::array<int,3>& dimensions, bool occupancy = false) const;
     std::string CGAL_precondition_evaluation(Surface other);
     bool does_bound_a_volume();
    
     std::vector<std::pair<Triangle_3, std::pair<int,int>>>  surface_segmentation(int nb_of_patch_plus_one=1,double angle_in_degree=85);
+    std::vector<std::pair<int,int>> face_segmentation(int nb_of_patch_plus_one=1,double angle_in_degree=85);
  
     // TODO : templates or "overloaded functions" same funtion one line difference ? 
     template <int A=0> 
@@ -866,6 +964,15 @@ class Surface
   
     template< int A=0>
     std::pair<bool,int>  manipulate_vertex_selection(Surface &other, double adjustment,  double smoothing, int max_iter);  
+
+    /**
+     * @brief Returns the work of each iteration of the last vertex selection manipulation,
+     * i.e. embed or enclose. The keys are iteration, selected_vertices,
+     * reclassified_vertices, total_vertices and time in seconds.
+     * @param none
+     * @return a report for each iteration.
+     */
+    std::vector<Parameters> get_vertex_selection_report() const { return vertex_selection_report; }
     
     template<int A=0>
     std::pair<bool,int> manipulate_vertex_selection_with_direction(Surface &other, double adjustment, int max_iter);
@@ -937,6 +1044,11 @@ class Surface
    double average_edge_length();
    protected:
     Mesh mesh;
+    mutable std::unique_ptr<Inside> inside_query;
+    mutable std::unique_ptr<Tree> vertex_tree;
+    mutable std::unique_ptr<Face_tree> face_tree;
+    mutable std::mutex cache_mutex;
+    std::vector<Parameters> vertex_selection_report;
     
 
 };
@@ -1030,7 +1142,7 @@ inline Surface::vertex_vector Surface::get_vertices_with_property(Surface &other
 {
    assert_non_empty_mesh();
    vertex_vector result;
-   Surface::Inside is_inside_query(other.get_mesh()); 
+   const Surface::Inside& is_inside_query = other.get_inside_query(); 
    for ( vertex_descriptor vit : mesh.vertices() )
    {
       CGAL::Bounded_side res =  is_inside_query(mesh.point(vit));
@@ -1055,7 +1167,7 @@ inline Surface::vertex_vector Surface::get_vertices_with_property(Surface &other
 {
    assert_non_empty_mesh();
    vertex_vector result;
-   Surface::Inside is_inside_query(other.get_mesh()); 
+   const Surface::Inside& is_inside_query = other.get_inside_query(); 
    for ( vertex_descriptor vit : vertices )
    {
       CGAL::Bounded_side res =  is_inside_query(mesh.point(vit));
@@ -1084,7 +1196,7 @@ inline std::pair<bool,bool> Surface::check_vertices(Surface &other)
    assert_non_empty_mesh();
    bool  query1 = false; 
    bool  query2 = false; 
-   Surface::Inside is_inside_query(other.get_mesh()); 
+   const Surface::Inside& is_inside_query = other.get_inside_query(); 
    for ( vertex_descriptor vit : mesh.vertices() )
    {
       CGAL::Bounded_side res =  is_inside_query(mesh.point(vit));
@@ -1172,17 +1284,12 @@ inline Surface::vertex_vector Surface::get_close_vertices(Surface &other)
 {
    assert_non_empty_mesh();
    
-   CGAL::Polygon_mesh_processing::remove_isolated_vertices(mesh);
+   if ( CGAL::Polygon_mesh_processing::remove_isolated_vertices(mesh) > 0 )
+      invalidate_caches();
 
    Surface::vertex_vector results;
-   Vertex_point_pmap vppmap = get(CGAL::vertex_point,other.get_mesh());  
-
-   Tree tree(vertices(other.get_mesh()).begin(),   // other.get_mesh().vertices().begin()?? 
-            vertices(other.get_mesh()).end(),
-            Splitter(),
-            Traits(vppmap)
-   );
-   Distance tr_dist(vppmap);
+   const Tree& tree = other.get_vertex_tree();
+   Distance tr_dist(other.mesh.points());
    FT distance, edgeL;
    Point_3 closest;
    Vector_3 direction,normal;
@@ -1194,7 +1301,7 @@ inline Surface::vertex_vector Surface::get_close_vertices(Surface &other)
         
         K_neighbor_search search(tree, mesh.point(vit), 2,0,true,tr_dist); 
         
-        closest = other.get_mesh().point((search.begin()+A)->first); 
+        closest = other.mesh.point((search.begin()+A)->first); 
 
         Point_3 current = mesh.point(vit);
         
@@ -1240,17 +1347,12 @@ inline Surface::vertex_vector Surface::get_close_vertices(Surface &other, Surfac
 {
    assert_non_empty_mesh();
    
-   CGAL::Polygon_mesh_processing::remove_isolated_vertices(mesh);
+   if ( CGAL::Polygon_mesh_processing::remove_isolated_vertices(mesh) > 0 )
+      invalidate_caches();
 
    Surface::vertex_vector results;
-   Vertex_point_pmap vppmap = get(CGAL::vertex_point,other.get_mesh());  
-
-   Tree tree(vertices(other.get_mesh()).begin(),
-            vertices(other.get_mesh()).end(),
-            Splitter(),
-            Traits(vppmap)
-   );
-   Distance tr_dist(vppmap);
+   const Tree& tree = other.get_vertex_tree();
+   Distance tr_dist(other.mesh.points());
    FT distance, edgeL;
    Point_3 closest;
    Vector_3 direction,normal;
@@ -1262,7 +1364,7 @@ inline Surface::vertex_vector Surface::get_close_vertices(Surface &other, Surfac
         
         K_neighbor_search search(tree, mesh.point(vit), 2,0,true,tr_dist); 
         
-        closest = other.get_mesh().point((search.begin()+A)->first); 
+        closest = other.mesh.point((search.begin()+A)->first); 
 
         Point_3 current = mesh.point(vit);
         
@@ -1313,18 +1415,13 @@ inline Surface::vertex_vector_map Surface::get_close_vertices_with_direction(Sur
    //   throw InvalidArgumentError("The adjust must be negative, i.e. contraction.");
 
    assert_non_empty_mesh();
-   CGAL::Polygon_mesh_processing::remove_isolated_vertices(mesh); 
+   if ( CGAL::Polygon_mesh_processing::remove_isolated_vertices(mesh) > 0 )
+      invalidate_caches(); 
      
    vertex_vector_map results;
    
-   Vertex_point_pmap vppmap = get(CGAL::vertex_point,other.get_mesh());
-   Tree tree(vertices(other.get_mesh()).begin(),
-            vertices(other.get_mesh()).end(),
-            Splitter(),
-            Traits(vppmap)
-   );
-
-   Distance tr_dist(vppmap);
+   const Tree& tree = other.get_vertex_tree();
+   Distance tr_dist(other.mesh.points());
 
    FT distance,edgeL;
    Point_3 closest;
@@ -1336,7 +1433,7 @@ inline Surface::vertex_vector_map Surface::get_close_vertices_with_direction(Sur
     
         K_neighbor_search search(tree, mesh.point(vit), 2,0,true,tr_dist); 
         
-        closest = other.get_mesh().point((search.begin()+A)->first); 
+        closest = other.mesh.point((search.begin()+A)->first); 
 
         Point_3 current = mesh.point(vit);
 
@@ -1403,31 +1500,69 @@ inline Surface::vertex_vector Surface::get_narrow_gaps()
  * reached. The integer is the number of vertex manipulation that
  * is completed.  
  *
+ * @note After each iteration only the moved vertices are reclassified, 
+ * and the work is recorded, @see Surface::get_vertex_selection_report.
+ *
  * FIXME
  */
 template< CGAL::Bounded_side A , CGAL::Bounded_side B>
 inline std::pair<bool,int> Surface::manipulate_vertex_selection(Surface &other, double adjustment,  double smoothing, int max_iter)
 {
+   typedef std::chrono::steady_clock Clock;
+   vertex_selection_report.clear();
    std::map< vertex_descriptor, double> se_map;
    vertex_vector vertices = get_vertices_with_property<A,B>(other) ;
    int after=0;
    int before = vertices.size();
-      
+
+   // The query of other is built once, unless other is this surface and moves with it.
+   const bool fixed_other = ( &other != this );
+   const Inside* is_inside_query = fixed_other ? &other.get_inside_query() : nullptr;
+
    int iter = 0;
    while ( !vertices.empty())
    {     
-   
+       const Clock::time_point start = Clock::now();
 
        se_map = get_shortest_edge_map(vertices,adjustment);  
          
        adjust_vertices_in_region(se_map.begin() ,se_map.end());
        
        smooth_laplacian_region(vertices.begin(),vertices.end(),smoothing);  
-            
-       vertices = this->get_vertices_with_property<A,B>(other);
+
+       // Only the selected vertices are moved, and the other vertices keep their
+       // classification, so the new selection is the moved vertices that still qualify.
+       std::size_t reclassified = 0;
+       if ( fixed_other )
+       {
+          vertex_vector moved;
+          moved.swap(vertices);
+          for ( vertex_descriptor vit : moved )
+          {
+             if ( mesh.is_removed(vit) )
+                continue;
+             ++reclassified;
+             CGAL::Bounded_side res = (*is_inside_query)(mesh.point(vit));
+             if ( res == A or res == B )
+                vertices.push_back(vit);
+          }
+       }
+       else
+       {
+          vertices = this->get_vertices_with_property<A,B>(other);
+          reclassified = mesh.number_of_vertices();
+       }
 
        after = vertices.size();    
 
+       Parameters report;
+       report["iteration"] = iter;
+       report["selected_vertices"] = after;
+       report["reclassified_vertices"] = reclassified;
+       report["total_vertices"] = mesh.number_of_vertices();
+       report["time"] = std::chrono::duration<double>(Clock::now() - start).count();
+       vertex_selection_report.push_back(report);
+
        if (++iter>max_iter and after>0)
           return std::make_pair(false, after);
        if ( after > before ) 
@@ -1566,7 +1701,8 @@ inline std::pair<bool,int> Surface::manipulate_vertex_selection_with_direction(S
 inline std::pair<bool,int>  Surface::separate_narrow_gaps(double adjustment, double smoothing, int max_iter) 
 {
    assert_non_empty_mesh();
-   CGAL::Polygon_mesh_processing::remove_isolated_vertices(mesh); 
+   if ( CGAL::Polygon_mesh_processing::remove_isolated_vertices(mesh) > 0 )
+      invalidate_caches(); 
    
    if (adjustment >0)
       throw  InvalidArgumentError("Adjusment must be negative.");
@@ -1591,7 +1727,8 @@ inline std::pair<bool,int>  Surface::separate_narrow_gaps(double adjustment, dou
 inline std::pair<bool,int>  Surface::separate_close_vertices(double adjustment, int max_iter) 
 {
    assert_non_empty_mesh();
-   CGAL::Polygon_mesh_processing::remove_isolated_vertices(mesh); 
+   if ( CGAL::Polygon_mesh_processing::remove_isolated_vertices(mesh) > 0 )
+      invalidate_caches(); 
    
    if (adjustment <0)
       throw  InvalidArgumentError("Adjusment must be positive.");
@@ -1700,22 +1837,24 @@ inline double Surface::average_edge_length()
 /* -- Surface Mesh Segmentation -- */ //TODO RENAME
 
 /**
- * @brief Segments the surface, called Domain::boundary_segmentation function.
+ * @brief Segments the surface, and returns the segmentation tag of each face.
  *
  * Used CGAL function sharp edges segmentation that marks sharp edges 
  * and segments facet restricted by marked edges.   
  * @see [sharp_edges_segmentation](https://doc.cgal.org/latest/Polygon_mesh_processing/group__PMP__detect__features__grp.html) 
  *
+ * @note The tags are in the order of the faces in the surface mesh, which is the order 
+ * of the faces used to construct the surface. Domain::boundary_segmentations uses this 
+ * to map the tags back to the mesh facets.  
  * @param nb_of_patch_plus_one used as the initial value to mark the surface segmentations. 
- * @return vector of facets points represented as triangles and associated tags. 
+ * @param angle_in_degree the threshold angle used to detect sharp edges.
+ * @return vector of tags, one for each face. 
  */
-inline  std::vector<std::pair<Surface::Triangle_3 , std::pair<int,int>>> Surface::surface_segmentation(int nb_of_patch_plus_one, double angle_in_degree)
+inline std::vector<std::pair<int,int>> Surface::face_segmentation(int nb_of_patch_plus_one, double angle_in_degree)
 {
     typedef boost::property_map<Mesh,CGAL::edge_is_feature_t>::type EIFMap; 
     EIFMap eif = get(CGAL::edge_is_feature, mesh);
     
-    //std::size_t number_of_patches;                
-
     Mesh::Property_map<face_descriptor, std::pair<int,int> > patch_id_map;
     Mesh::Property_map<vertex_descriptor,std::set<std::pair<int,int> > > vertex_incident_patch_map;                      
 
@@ -1726,9 +1865,30 @@ inline  std::vector<std::pair<Surface::Triangle_3 , std::pair<int,int>>> Surface
                                      CGAL::Polygon_mesh_processing::parameters::first_index(nb_of_patch_plus_one)
                                     .vertex_incident_patches_map(vertex_incident_patch_map));
 
+   std::vector<std::pair<int,int>> tags;
+   tags.reserve(mesh.number_of_faces());
+   for ( face_descriptor f : mesh.faces())
+      tags.push_back(get(patch_id_map,f));
+   return tags;
+}
+
+/**
+ * @brief Segments the surface.
+ *
+ * @see Surface::face_segmentation
+ * @param nb_of_patch_plus_one used as the initial value to mark the surface segmentations. 
+ * @param angle_in_degree the threshold angle used to detect sharp edges.
+ * @return vector of facets points represented as triangles and associated tags. 
+ */
+inline  std::vector<std::pair<Surface::Triangle_3 , std::pair<int,int>>> Surface::surface_segmentation(int nb_of_patch_plus_one, double angle_in_degree)
+{
+   std::vector<std::pair<int,int>> tags = face_segmentation(nb_of_patch_plus_one, angle_in_degree);
+
    std::vector<std::pair<Triangle_3,std::pair<int,int>>> Tri2tagvec;
+   Tri2tagvec.reserve(tags.size());
    Vertex_point_pmap vpm = get(CGAL::vertex_point,mesh);
 
+   std::size_t i = 0;
    for ( face_descriptor f : mesh.faces())
    {
       halfedge_descriptor he = mesh.halfedge(f);
@@ -1738,9 +1898,7 @@ inline  std::vector<std::pair<Surface::Triangle_3 , std::pair<int,int>>> Surface
       he = mesh.next(he);
       Point_3 p3 = get(vpm,mesh.source(he));
 
-      Triangle_3 tri(p1,p2,p3);
-
-      Tri2tagvec.push_back(std::make_pair(tri,get(patch_id_map,f)));     
+      Tri2tagvec.push_back(std::make_pair(Triangle_3(p1,p2,p3),tags[i++]));     
    }
    return Tri2tagvec;
 }
@@ -1756,23 +1914,185 @@ inline bool Surface::does_bound_a_volume()
 }
 
 /**
- * @brief Computes the distance between a point and the closest vertex in 
- * the triangulated surface.
+ * @brief Computes the distance between a point and the triangulated surface.
  * 
  * @param point SVMTK Surface Point_3 object. 
- * @return the distance from point and the closest vertex in the surface
+ * @return the distance from point to the closest point on the surface.
  */
 inline double Surface::distance_to_point(Surface::Point_3 point)
 {
+   return std::sqrt(CGAL::to_double(get_face_tree().squared_distance(point)));
+}
 
-   vertex_vector vertices = get_closest_vertices(point,1);
-   if (vertices.size()==0)
-       return 0;
-   assert_non_empty_mesh();
+/**
+ * @brief Computes the signed distance between a point and the triangulated surface,
+ * which is negative inside and positive outside the surface.
+ * 
+ * @param point SVMTK Surface Point_3 object. 
+ * @return the signed distance from point to the closest point on the surface.
+ * @throws PreconditionError if the surface is not closed.
+ */
+inline double Surface::signed_distance_to_point(Surface::Point_3 point)
+{
+   const double coordinates[3] = {CGAL::to_double(point.x()), CGAL::to_double(point.y()), CGAL::to_double(point.z())};
+   double distance;
+   distance_to_points(coordinates, 1, true, &distance);
+   return distance;
+}
 
-   Vector_3 vector(mesh.point(vertices[0]),point);
-  
-   return CGAL::to_double(CGAL::sqrt(vector.squared_length()));
+/**
+ * @brief Computes the distances between points and the triangulated surface, with the closest 
+ * points and faces, in parallel if SVMTK is built with TBB.
+ *
+ * The signed distance is negative inside and positive outside the surface. 
+ * @param coordinates the x, y and z coordinates of each point.
+ * @param number_of_points the number of points.
+ * @param use_sign if true the distances are signed, which requires a closed surface.
+ * @param[out] distances the distance of each point.
+ * @param[out] closest_points the x, y and z coordinates of the closest point on the surface, ignored if null.
+ * @param[out] closest_faces the index of the face with the closest point, ignored if null.
+ * @return void
+ * @throws PreconditionError if use_sign is true and the surface is not closed.
+ */
+inline void Surface::distance_to_points(const double* coordinates, std::size_t number_of_points, bool use_sign, double* distances,
+                                        double* closest_points, std::int64_t* closest_faces) const
+{
+   const Face_tree& tree = get_face_tree();
+   if ( use_sign and !CGAL::is_closed(mesh) )
+      throw PreconditionError("Signed distances require a closed surface.");
+   const Inside* is_inside_query = use_sign ? &get_inside_query() : nullptr;
+
+   parallel_for_each_index(number_of_points, [&](std::size_t i)
+   {
+      const Point_3 point(coordinates[3*i], coordinates[3*i+1], coordinates[3*i+2]);
+      const Face_tree::Point_and_primitive_id closest = tree.closest_point_and_primitive(point);
+      double distance = std::sqrt(CGAL::to_double(CGAL::squared_distance(point, closest.first)));
+      if ( is_inside_query and (*is_inside_query)(point) == CGAL::ON_BOUNDED_SIDE )
+         distance = -distance;
+      distances[i] = distance;
+      if ( closest_points )
+      {
+         closest_points[3*i]   = CGAL::to_double(closest.first.x());
+         closest_points[3*i+1] = CGAL::to_double(closest.first.y());
+         closest_points[3*i+2] = CGAL::to_double(closest.first.z());
+      }
+      if ( closest_faces )
+         closest_faces[i] = static_cast<std::int64_t>(closest.second);
+   });
+}
+
+/**
+ * @brief Samples the signed distance field of the surface on a regular grid, in parallel over 
+ * z-slices if SVMTK is built with TBB.
+ *
+ * The sign is found by the parity of the crossings of a line in the x-direction through 
+ * each row of grid points. Rows where the line hits an edge, a vertex or lies in a face 
+ * use the inside query instead. The distance is negative inside the surface, and the
+ * values are ordered with x fastest and z slowest.
+ * @param origin the coordinates of the first grid point.
+ * @param spacing the grid spacing in each direction.
+ * @param dimensions the number of grid points in each direction.
+ * @param[out] values the signed distance at each of the grid points.
+ * @param occupancy if true the values are 1 inside and 0 outside the surface, and no distances are computed.
+ * @return void
+ * @throws InvalidArgumentError if the dimensions or spacing are not positive.
+ * @throws PreconditionError if the surface is not closed.
+ */
+inline void Surface::signed_distance_field(const std::array<double,3>& origin, const std::array<double,3>& spacing,
+                                           const std::array<int,3>& dimensions, float* values, bool occupancy) const
+{
+   typedef Kernel::Line_3 Line_3;
+   typedef boost::optional<Face_tree::Intersection_and_primitive_id<Line_3>::Type> Line_intersection;
+
+   for ( int k = 0; k < 3; ++k )
+   {
+      if ( dimensions[k] <= 0 or !(spacing[k] > 0) )
+         throw InvalidArgumentError("Grid dimensions and spacing must be positive.");
+   }
+   const Face_tree& tree = get_face_tree();
+   if ( !CGAL::is_closed(mesh) )
+      throw PreconditionError("Signed distance fields require a closed surface.");
+   const Inside& is_inside_query = get_inside_query();
+
+   const std::size_t nx = dimensions[0];
+   const std::size_t ny = dimensions[1];
+   const CGAL::Bbox_3 bbox = tree.bbox();
+   const double tolerance = 1.e-9*(bbox.xmax() - bbox.xmin() + 1.0);
+
+   parallel_for_each_index(static_cast<std::size_t>(dimensions[2]), [&](std::size_t k)
+   {
+      std::vector<Line_intersection> intersections;
+      std::vector<double> crossings;
+      const double z = origin[2] + k*spacing[2];
+      for ( std::size_t j = 0; j < ny; ++j )
+      {
+         const double y = origin[1] + j*spacing[1];
+         float* row = values + nx*(j + ny*k);
+         intersections.clear();
+         crossings.clear();
+         bool use_parity = true;
+         if ( y >= bbox.ymin() and y <= bbox.ymax() and z >= bbox.zmin() and z <= bbox.zmax() )
+         {
+            tree.all_intersections(Line_3(Point_3(origin[0], y, z), Vector_3(1, 0, 0)), std::back_inserter(intersections));
+            for ( const Line_intersection& intersection : intersections )
+            {
+               const Point_3* point = boost::get<Point_3>(&(intersection->first));
+               if ( !point )
+               {
+                  use_parity = false;
+                  break;
+               }
+               crossings.push_back(CGAL::to_double(point->x()));
+            }
+            std::sort(crossings.begin(), crossings.end());
+            for ( std::size_t c = 1; use_parity and c < crossings.size(); ++c )
+               use_parity = crossings[c] - crossings[c-1] > tolerance;
+            use_parity = use_parity and crossings.size() % 2 == 0;
+         }
+
+         std::size_t c = 0;
+         for ( std::size_t i = 0; i < nx; ++i )
+         {
+            const double x = origin[0] + i*spacing[0];
+            const Point_3 point(x, y, z);
+            bool inside;
+            if ( use_parity )
+            {
+               while ( c < crossings.size() and crossings[c] < x )
+                  ++c;
+               inside = c % 2 == 1;
+            }
+            else
+               inside = is_inside_query(point) != CGAL::ON_UNBOUNDED_SIDE;
+
+            if ( occupancy )
+               row[i] = inside ? 1.0f : 0.0f;
+            else
+            {
+               const float distance = static_cast<float>(std::sqrt(CGAL::to_double(tree.squared_distance(point))));
+               row[i] = inside ? -distance : distance;
+            }
+         }
+      }
+   });
+}
+
+/**
+ * @brief Samples the signed distance field of the surface on a regular grid, and writes it to a raw or NRRD file.
+ * @see Surface::signed_distance_field and write_volume.
+ * @param path the path to the file with extension nrrd or raw.
+ * @param origin the coordinates of the first grid point.
+ * @param spacing the grid spacing in each direction.
+ * @param dimensions the number of grid points in each direction.
+ * @param occupancy if true the values are 1 inside and 0 outside the surface.
+ * @return void
+ */
+inline void Surface::save_signed_distance_field(const std::string& path, const std::array<double,3>& origin, const std::array<double,3>& spacing,
+                                                const std::array<int,3>& dimensions, bool occupancy) const
+{
+   std::vector<float> values(static_cast<std::size_t>(std::max(dimensions[0],0))*std::max(dimensions[1],0)*std::max(dimensions[2],0));
+   signed_distance_field(origin, spacing, dimensions, values.data(), occupancy);
+   write_volume(path, values.data(), dimensions, origin, spacing);
 }
 
 /**
@@ -1803,6 +2123,7 @@ inline std::string Surface::CGAL_precondition_evaluation(Surface other)
  */
 inline void Surface::set_outward_face_orientation()
 {
+  invalidate_caches();
   assert_non_empty_mesh();
   if (CGAL::is_closed(mesh) && (!CGAL::Polygon_mesh_processing::is_outward_oriented(mesh)))
   {
@@ -1827,6 +2148,7 @@ inline void Surface::set_outward_face_orientation()
  */
 inline bool Surface::surface_intersection(Surface other)
 {
+   invalidate_caches();
    assert_non_empty_mesh();
    other.assert_non_empty_mesh();
 
@@ -1858,6 +2180,7 @@ inline bool Surface::surface_intersection(Surface other)
  */
 inline bool Surface::surface_difference(Surface other)
 {    
+   invalidate_caches();
    assert_non_empty_mesh();
    other.assert_non_empty_mesh();
 
@@ -1887,6 +2210,7 @@ inline bool Surface::surface_difference(Surface other)
  */
 inline bool Surface::surface_union(Surface other)
 {  
+   invalidate_caches();
    assert_non_empty_mesh();
    other.assert_non_empty_mesh();
    try 
@@ -1911,6 +2235,7 @@ inline bool Surface::surface_union(Surface other)
  */ 
 inline int Surface::keep_largest_connected_component()
 {
+ invalidate_caches();
  return CGAL::Polygon_mesh_processing::keep_largest_connected_components(mesh,1);
 }
 
@@ -1924,17 +2249,10 @@ inline int Surface::keep_largest_connected_component()
 inline Surface::vertex_vector Surface::get_closest_vertices(Point_3 p1, int num)
 {
    
-   Vertex_point_pmap vppmap = get(CGAL::vertex_point,mesh); 
    vertex_vector results;
+   const Tree& tree = get_vertex_tree();
+   Distance tr_dist(mesh.points());
 
-   Tree tree(vertices(mesh).begin(),
-            vertices(mesh).end(),
-            Splitter(),
-            Traits(vppmap)
-   );
-
-   Distance tr_dist(vppmap);
-   
    K_neighbor_search search(tree,p1, num,0,true,tr_dist); 
  
    for ( auto vit=search.begin() ; vit!=search.end(); ++ vit) 
@@ -1944,6 +2262,79 @@ inline Surface::vertex_vector Surface::get_closest_vertices(Point_3 p1, int num)
    return results;
 } 
 
+/**
+ * @brief Finds the k closest vertices of each query point, in parallel if SVMTK is built with TBB.
+ *
+ * The vertex indices are the indices of the vertices in the surface mesh. If the surface
+ * has fewer than k vertices, the remaining indices are -1 and the distances are infinite.
+ * @param coordinates the x, y and z coordinates of each query point.
+ * @param number_of_points the number of query points.
+ * @param k the number of closest vertices of each point.
+ * @param[out] indices k vertex indices for each point, sorted by distance.
+ * @param[out] distances k distances for each point.
+ * @return void
+ * @throws InvalidArgumentError if k is not positive.
+ */
+inline void Surface::get_closest_vertices(const double* coordinates, std::size_t number_of_points, int k,
+                                          std::int64_t* indices, double* distances) const
+{
+   if ( k <= 0 )
+      throw InvalidArgumentError("Number of closest vertices must be positive.");
+   const Tree& tree = get_vertex_tree();
+   Distance tr_dist(mesh.points());
+   parallel_for_each_index(number_of_points, [&](std::size_t i)
+   {
+      K_neighbor_search search(tree, Point_3(coordinates[3*i], coordinates[3*i+1], coordinates[3*i+2]), k, 0, true, tr_dist);
+      std::size_t j = static_cast<std::size_t>(k)*i;
+      for ( auto vit = search.begin(); vit != search.end(); ++vit, ++j )
+      {
+         indices[j] = static_cast<std::int64_t>(vit->first);
+         distances[j] = std::sqrt(CGAL::to_double(vit->second));
+      }
+      for ( ; j < static_cast<std::size_t>(k)*(i+1); ++j )
+      {
+         indices[j] = -1;
+         distances[j] = std::numeric_limits<double>::infinity();
+      }
+   });
+}
+
+/**
+ * @brief Finds the vertices within a radius of each query point, in parallel if SVMTK is built with TBB.
+ *
+ * The result is stored in compressed rows, where the vertices of point i are 
+ * indices[offsets[i]] to indices[offsets[i+1]-1] in no particular order.
+ * @param coordinates the x, y and z coordinates of each query point.
+ * @param number_of_points the number of query points.
+ * @param radius the search radius.
+ * @param[out] offsets number_of_points+1 offsets into indices.
+ * @param[out] indices vertex indices.
+ * @return void
+ * @throws InvalidArgumentError if radius is negative.
+ */
+inline void Surface::get_vertices_within_radius(const double* coordinates, std::size_t number_of_points, double radius,
+                                                std::vector<std::int64_t>& offsets, std::vector<std::int64_t>& indices) const
+{
+   if ( radius < 0 )
+      throw InvalidArgumentError("Radius must be non-negative.");
+   const Tree& tree = get_vertex_tree();
+   std::vector<std::vector<vertex_descriptor>> found(number_of_points);
+   parallel_for_each_index(number_of_points, [&](std::size_t i)
+   {
+      Fuzzy_sphere sphere(Point_3(coordinates[3*i], coordinates[3*i+1], coordinates[3*i+2]), radius, 0, tree.traits());
+      tree.search(std::back_inserter(found[i]), sphere);
+   });
+   offsets.assign(number_of_points+1, 0);
+   for ( std::size_t i = 0; i < number_of_points; ++i )
+      offsets[i+1] = offsets[i] + static_cast<std::int64_t>(found[i].size());
+   indices.resize(offsets.back());
+   parallel_for_each_index(number_of_points, [&](std::size_t i)
+   {
+      std::transform(found[i].begin(), found[i].end(), indices.begin() + offsets[i],
+                     [](vertex_descriptor v) { return static_cast<std::int64_t>(v); });
+   });
+}
+
 /**
  * @brief Finds a specified number mesh points that are closest to a point not on the mesh. 
  *
@@ -2066,18 +2457,12 @@ inline std::shared_ptr<Surface> Surface::cylindric_extension(const Point_3& p1,
  *
  */
 
-inline std::shared_ptr<Surface> Surface::cylindric_connection(Surface other, double radius, double edge_length)
+inline std::shared_ptr<Surface> Surface::cylindric_connection(const Surface& other, double radius, double edge_length)
 {
    assert_non_empty_mesh();
    Surface::vertex_vector results;
-   Vertex_point_pmap vppmap = get(CGAL::vertex_point,other.get_mesh());  
-
-   Tree tree(vertices(other.get_mesh()).begin(),
-            vertices(other.get_mesh()).end(),
-            Splitter(),
-            Traits(vppmap)
-   );
-   Distance tr_dist(vppmap);
+   const Tree& tree = other.get_vertex_tree();
+   Distance tr_dist(other.mesh.points());
    FT distance;
    FT min_distance = FT(std::numeric_limits<double>::max());
    Point_3 query_point,p0,p1,p2,p3;
@@ -2088,7 +2473,7 @@ inline std::shared_ptr<Surface> Surface::cylindric_connection(Surface other, dou
    {
         K_neighbor_search search(tree, mesh.point(vit), 2,0,true,tr_dist); 
         
-        query_point = other.get_mesh().point((search.begin())->first);
+        query_point = other.mesh.point((search.begin())->first);
 
         Point_3 current = mesh.point(vit);
         distance = CGAL::squared_distance(current,query_point);
@@ -2139,7 +2524,8 @@ inline std::map<Surface::vertex_descriptor, double> Surface::get_shortest_edge_m
 {
 
    assert_non_empty_mesh();
-   CGAL::Polygon_mesh_processing::remove_isolated_vertices(mesh);
+   if ( CGAL::Polygon_mesh_processing::remove_isolated_vertices(mesh) > 0 )
+      invalidate_caches();
    
    std::map< vertex_descriptor, double> results;
    for (vertex_descriptor vit : vector)
@@ -2194,6 +2580,7 @@ void Surface::implicit_surface(Implicit_function implicit_function,
              double radius_bound,
              double distance_bound)
 {
+     invalidate_caches();
      surface_mesher(mesh,implicit_function,bounding_sphere_radius,angular_bound,radius_bound, distance_bound);
 }
 
@@ -2209,6 +2596,7 @@ void Surface::implicit_surface(Implicit_function implicit_function,
 template<typename InputIterator >
 void Surface::adjust_vertices_in_region(InputIterator begin , InputIterator  end, const double c)
 { 
+  invalidate_caches();
   assert_non_empty_mesh();
   std::vector<std::pair<vertex_descriptor, Point_3> > adjust; 
   for ( ; begin != end; ++begin)
@@ -2232,6 +2620,7 @@ void Surface::adjust_vertices_in_region(InputIterator begin , InputIterator  end
  */
 inline void Surface::adjust_vertices_in_region(vertex_scalar_map::iterator begin, vertex_scalar_map::iterator end) 
 {
+ invalidate_caches();
  assert_non_empty_mesh();
   std::vector<std::pair<vertex_descriptor, Point_3> > adjust; 
   for ( ; begin != end; ++begin)
@@ -2256,6 +2645,7 @@ inline void Surface::adjust_vertices_in_region(vertex_scalar_map::iterator begin
  */
 inline void Surface::adjust_vertices_in_region(vertex_vector_map::iterator begin, vertex_vector_map::iterator end) // map or two vectors
 {
+  invalidate_caches();
   for ( ; begin != end; ++begin)
   {
       Point_3 p = mesh.point(begin->first) + begin->second;
@@ -2279,6 +2669,7 @@ inline void Surface::adjust_vertices_in_region(vertex_vector_map::iterator begin
 template<typename InputIterator >
 inline void Surface::smooth_laplacian_region(InputIterator  begin , InputIterator  end ,const double c)
 {
+  invalidate_caches();
   assert_non_empty_mesh();
   CGAL::Polygon_mesh_processing::remove_isolated_vertices(mesh);
   std::vector<std::pair<vertex_descriptor, Point_3> > smoothed;
@@ -2314,6 +2705,7 @@ inline void Surface::smooth_laplacian_region(InputIterator  begin , InputIterato
  */
 inline void Surface::smooth_laplacian_region(vertex_vector_map::iterator begin, vertex_vector_map::iterator end ,const double c)
 {
+  invalidate_caches();
   assert_non_empty_mesh();
   CGAL::Polygon_mesh_processing::remove_isolated_vertices(mesh);
   std::vector<std::pair<vertex_descriptor, Point_3> > smoothed;
@@ -2444,6 +2836,7 @@ inline void Surface::get_normal_vector_cluster(Surface::vertex_vector &vertices,
  * @return void 
  */
 inline void Surface::smooth_taubin(const size_t nb_iter) {
+    invalidate_caches();
     for (size_t i = 0; i < nb_iter; ++i) {
         this->smooth_laplacian(0.8,1);  
         this->smooth_laplacian(-0.805,1);
@@ -2469,6 +2862,7 @@ inline void Surface::smooth_taubin(const size_t nb_iter) {
 template<typename InputIterator >
 void Surface::smooth_taubin_region(InputIterator begin , InputIterator end ,const size_t nb_iter)
 {
+    invalidate_caches();
     assert_non_empty_mesh();
     for (size_t i = 0; i < nb_iter; ++i) {
         this->smooth_laplacian_region(begin,end,0.8);
@@ -2496,6 +2890,7 @@ inline int Surface::num_self_intersections() {
  */
 inline int Surface::collapse_edges(const double target_edge_length)
 {
+    invalidate_caches();
     assert_non_empty_mesh();
     CGAL::Surface_mesh_simplification::Edge_length_stop_predicate<double> stop(target_edge_length);
 
@@ -2516,6 +2911,7 @@ inline int Surface::collapse_edges(const double target_edge_length)
  * @overload  
  */
 inline int Surface::collapse_edges() {
+    invalidate_caches();
     Cost_stop_predicate<Mesh> stop(1.e-6);
     const int r = CGAL::Surface_mesh_simplification::edge_collapse(
         mesh,
@@ -2619,6 +3015,7 @@ inline Surface::Polylines Surface::polylines_in_plane(Surface::Plane_3 plane_3)
  */
 inline void Surface::isotropic_remeshing(double target_edge_length, unsigned int nb_iter, bool protect_border)
 {
+     invalidate_caches();
      assert_non_empty_mesh();
      CGAL::Polygon_mesh_processing::split_long_edges(edges(mesh), target_edge_length,mesh);
      CGAL::Polygon_mesh_processing::isotropic_remeshing(faces(mesh),
@@ -2647,6 +3044,7 @@ inline void Surface::isotropic_remeshing(double target_edge_length, unsigned int
  */
 inline bool Surface::clip(double a,double b, double c ,double d, bool preserve_manifold)
 {      
+   invalidate_caches();
    assert_non_empty_mesh();
    return CGAL::Polygon_mesh_processing::clip(mesh, Plane_3(a,b,c,d), CGAL::Polygon_mesh_processing::parameters::clip_volume(preserve_manifold));
 }
@@ -2664,6 +3062,7 @@ inline bool Surface::clip(double a,double b, double c ,double d, bool preserve_m
  */
 inline bool Surface::clip(Point_3 point, Vector_3 vector , bool preserve_manifold)
 {
+   invalidate_caches();
    assert_non_empty_mesh();
    return CGAL::Polygon_mesh_processing::clip(mesh, Plane_3(point,vector), CGAL::Polygon_mesh_processing::parameters::clip_volume(preserve_manifold));
 }
@@ -2682,6 +3081,7 @@ inline bool Surface::clip(Point_3 point, Vector_3 vector , bool preserve_manifol
  */
 inline bool Surface::clip(Point_3 point, Vector_3 vector, double radius, bool invert  , bool preserve_manifold)
 {
+   invalidate_caches();
    Surface circle;
    
    circle.make_circle_in_plane(point, vector,radius, radius/10. ) ; 
@@ -2698,6 +3098,7 @@ inline bool Surface::clip(Point_3 point, Vector_3 vector, double radius, bool in
  */
 inline bool Surface::clip(Plane_3 plane, bool preserve_manifold)
 {
+   invalidate_caches();
    assert_non_empty_mesh();
    return CGAL::Polygon_mesh_processing::clip(mesh, plane, CGAL::Polygon_mesh_processing::parameters::clip_volume(preserve_manifold));
 }
@@ -2712,6 +3113,7 @@ inline bool Surface::clip(Plane_3 plane, bool preserve_manifold)
  */
 inline bool Surface::clip(Surface other,bool invert,bool preserve_manifold)
 {
+   invalidate_caches();
    assert_non_empty_mesh();
     if (invert) 
          CGAL::Polygon_mesh_processing::reverse_face_orientations(other.mesh);
@@ -2730,6 +3132,7 @@ inline bool Surface::clip(Surface other,bool invert,bool preserve_manifold)
  */
 inline int Surface::fill_holes()
 {
+    invalidate_caches();
     //assert_non_empty_mesh();
     unsigned int nb_holes = 0;
     BOOST_FOREACH(halfedge_descriptor h, halfedges(mesh))
@@ -2770,6 +3173,7 @@ inline int Surface::fill_holes()
  */
 inline bool Surface::triangulate_faces()
 {
+    invalidate_caches();
     assert_non_empty_mesh();
     CGAL::Polygon_mesh_processing::triangulate_faces(mesh);
 
@@ -2807,6 +3211,71 @@ inline std::vector<Surface::Point_3>  Surface::get_points()
    return result;
 } 
 
+/**
+ * @brief Returns the inside query of the surface mesh, i.e. CGAL::Side_of_triangle_mesh.
+ *
+ * The query and its AABB tree are built on the first call, and kept until the 
+ * surface mesh is changed. The build is locked, so the query can be requested 
+ * from several threads. 
+ * @param none
+ * @return the inside query of the surface mesh.
+ * @throws EmptyMeshError if the surface mesh is empty.
+ */
+inline const Surface::Inside& Surface::get_inside_query() const
+{
+     if ( mesh.is_empty() )
+        throw EmptyMeshError("Surface is empty") ;
+     std::lock_guard<std::mutex> lock(cache_mutex);
+     if ( !inside_query )
+        inside_query.reset(new Inside(mesh));
+     return *inside_query;
+}
+
+/**
+ * @brief Returns the k-d tree of the surface mesh vertices.
+ *
+ * The tree is built on the first call, and kept until the surface mesh is changed.
+ * The build is locked, as for get_inside_query.
+ * @param none
+ * @return the k-d tree of the vertices.
+ * @throws EmptyMeshError if the surface mesh is empty.
+ */
+inline const Surface::Tree& Surface::get_vertex_tree() const
+{
+     if ( mesh.is_empty() )
+        throw EmptyMeshError("Surface is empty") ;
+     std::lock_guard<std::mutex> lock(cache_mutex);
+     if ( !vertex_tree )
+     {
+        vertex_tree.reset(new Tree(vertices(mesh).begin(), vertices(mesh).end(), Splitter(), Traits(mesh.points())));
+        vertex_tree->build();
+     }
+     return *vertex_tree;
+}
+
+/**
+ * @brief Returns the AABB tree of the surface mesh faces, with accelerated distance queries.
+ *
+ * The tree is built on the first call, and kept until the surface mesh is changed.
+ * The build is locked, as for get_inside_query.
+ * @param none
+ * @return the AABB tree of the faces.
+ * @throws EmptyMeshError if the surface mesh is empty.
+ */
+inline const Surface::Face_tree& Surface::get_face_tree() const
+{
+     if ( mesh.is_empty() )
+        throw EmptyMeshError("Surface is empty") ;
+     std::lock_guard<std::mutex> lock(cache_mutex);
+     if ( !face_tree )
+     {
+        face_tree.reset(new Face_tree(faces(mesh).first, faces(mesh).second, mesh));
+        face_tree->build();
+        face_tree->accelerate_distance_queries();
+     }
+     return *face_tree;
+}
+
 /**
  * @brief Checks if a point is inside surface mesh.
  *  
@@ -2816,15 +3285,30 @@ inline std::vector<Surface::Point_3>  Surface::get_points()
  */
 inline bool Surface::is_point_inside(Point_3 point_3) 
 {
-     assert_non_empty_mesh();
-     Surface::Inside is_inside_query(mesh);
-     CGAL::Bounded_side res = is_inside_query(point_3);
+     CGAL::Bounded_side res = get_inside_query()(point_3);
      if (res == CGAL::ON_BOUNDED_SIDE or res == CGAL::ON_BOUNDARY)
          return true;
      else 
          return false;
 }
 
+/**
+ * @brief Checks if points are inside surface mesh, in parallel if SVMTK is built with TBB.
+ * @param coordinates the x, y and z coordinates of each point.
+ * @param number_of_points the number of points.
+ * @param[out] inside true for points inside or on the surface, otherwise false.
+ * @return void
+ */
+inline void Surface::is_point_inside(const double* coordinates, std::size_t number_of_points, bool* inside) 
+{
+     const Inside& is_inside_query = get_inside_query();
+     parallel_for_each_index(number_of_points, [&](std::size_t i)
+     {
+        CGAL::Bounded_side res = is_inside_query(Point_3(coordinates[3*i], coordinates[3*i+1], coordinates[3*i+2]));
+        inside[i] = ( res == CGAL::ON_BOUNDED_SIDE or res == CGAL::ON_BOUNDARY );
+     });
+}
+
 /**
  * @brief Adjust surface mesh vertex coordinates in the normal vertex direction multiplied with an 
  * argument value.
@@ -2834,6 +3318,7 @@ inline bool Surface::is_point_inside(Point_3 point_3)
  */
 inline void Surface::adjust_boundary(const double c)
 {
+    invalidate_caches();
     assert_non_empty_mesh();
     Mesh::Vertex_range::iterator  vb = mesh.vertices().begin(), ve=mesh.vertices().end();
     Surface::adjust_vertices_in_region(vb, ve,c);
@@ -2852,6 +3337,7 @@ inline void Surface::adjust_boundary(const double c)
  */
 inline void Surface::smooth_laplacian(const double c, int iter)
 {
+    invalidate_caches();
     assert_non_empty_mesh();
     Mesh::Vertex_range::iterator  vb = mesh.vertices().begin(), ve=mesh.vertices().end();
     for ( int i = 0 ; i< iter ; ++i)
@@ -2872,6 +3358,7 @@ inline void Surface::smooth_laplacian(const double c, int iter)
  */
 inline void Surface::smooth_shape(double time,int nb_iterations)
 {
+    invalidate_caches();
     assert_non_empty_mesh();
     CGAL::Polygon_mesh_processing::smooth_shape(mesh, time, CGAL::Polygon_mesh_processing::parameters::number_of_iterations(nb_iterations));
 }
@@ -2961,13 +3448,10 @@ inline Surface::Polyline Surface::get_shortest_surface_path(Point_3 source, Poin
       typedef CGAL::Surface_mesh_shortest_path_traits<Kernel, Mesh> Traits;
       typedef CGAL::Surface_mesh_shortest_path<Traits> Surface_mesh_shortest_path;
       typedef Surface_mesh_shortest_path::Face_location Face_location;
-      typedef CGAL::AABB_face_graph_triangle_primitive<Mesh> Primitive;
-      typedef CGAL::AABB_traits<Kernel, Primitive> AABB_Traits;
-      typedef CGAL::AABB_tree<AABB_Traits> Tree;
 
       std::vector<Surface::Point_3> points;
 
-      Tree tree(faces(mesh).first, faces(mesh).second, mesh); 
+      const Face_tree& tree = get_face_tree(); 
       Surface_mesh_shortest_path shortest_paths(mesh);     
 
       Face_location source_location = shortest_paths.locate(source,tree);
@@ -2995,6 +3479,7 @@ inline Surface::Polyline Surface::get_shortest_surface_path(Point_3 source, Poin
  */
 inline void Surface::make_cube( double x0, double y0, double  z0,  double x1, double y1, double z1, double edge_length) 
 {
+     invalidate_caches();
      typedef boost::multi_array<int, 3> array_type;
      
      std::vector<face_vector> sides;
@@ -3115,6 +3600,7 @@ inline void Surface::make_cube( double x0, double y0, double  z0,  double x1, do
  */
 inline void Surface::make_circle_in_plane(Point_3 point, Vector_3 vector, double radius, double edge_length) 
 {
+     invalidate_caches();
      face_vector fv1,fv3;
 
      Index v0 = mesh.add_vertex(point);
@@ -3171,6 +3657,7 @@ inline void Surface::make_circle_in_plane(Point_3 point, Vector_3 vector, double
  */
 inline void Surface::make_cylinder( double x0, double y0, double  z0,  double x1, double y1, double z1, double r0,  double edge_length)
 {    
+     invalidate_caches();
      clear();
      Surface::make_cone( x0, y0,z0, x1,y1, z1, r0 , r0, edge_length ) ;
 }
@@ -3193,6 +3680,7 @@ inline void Surface::make_cylinder( double x0, double y0, double  z0,  double x1
  */
 inline void Surface::make_cone_( double x0, double y0, double  z0,  double x1, double y1, double z1, double r0, double edge_length) 
 {
+     invalidate_caches();
      clear();
      face_vector fv1,fv3;
 
@@ -3267,6 +3755,7 @@ inline void Surface::make_cone_( double x0, double y0, double  z0,  double x1, d
  */
 inline void Surface::make_cone( double x0, double y0, double  z0,  double x1, double y1, double z1, double r0, double r1,  double edge_length) 
 {
+     invalidate_caches();
 
 
      if ((r0*r0 +r1*r1)==0) 
@@ -3355,31 +3844,19 @@ inline void Surface::make_cone( double x0, double y0, double  z0,  double x1, do
 
 /**
  * \struct 
- * @brief Implicit function for a sphere with static center and radius.
+ * @brief Implicit function for a sphere with center and radius.
  * 
  */
 struct sphere_wrapper{
         
      public:
-        static double radius;
-        static double x0;
-        static double y0;
-        static double z0;
-        static double function(double x, double y , double z) { return  (x-x0)*(x -x0) +  (y-y0)*(y -y0) + (z-z0)*(z -z0) -radius*radius; }
+        double radius = 0;
+        double x0 = 0;
+        double y0 = 0;
+        double z0 = 0;
+        double operator()(double x, double y , double z) const { return  (x-x0)*(x -x0) +  (y-y0)*(y -y0) + (z-z0)*(z -z0) -radius*radius; }
 };
 
-
-/**
- * @brief  FIXME ??
- * @note inline declaration of static variables in header files requrie c++ version equal or greate than 7 
- *       with the compiler option c++1z/c++17
- * @hideinitializer
- */
-inline double sphere_wrapper::radius = 0; // inline declaration of static variable radius for sphere wrapper 
-inline double sphere_wrapper::x0 = 0;     // inline declaration of static variable radius for sphere wrapper
-inline double sphere_wrapper::y0 = 0;     // inline declaration of static variable radius for sphere wrapper
-inline double sphere_wrapper::z0 = 0;     // inline declaration of static variable radius for sphere wrapper
-
 /**
  * @brief Creates a sphere surface mesh.
  * 
@@ -3395,6 +3872,7 @@ inline double sphere_wrapper::z0 = 0;     // inline declaration of static variab
  */
 inline void Surface::make_sphere( double x0, double y0, double  z0,double r0, double edge_length) 
 {    
+   invalidate_caches();
    if (6.28*r0 < 3*edge_length) 
        throw  InvalidArgumentError("Select smaller edge length."); 
   
@@ -3404,7 +3882,7 @@ inline void Surface::make_sphere( double x0, double y0, double  z0,double r0, do
   sphere.x0=x0;
   sphere.y0=y0;
   sphere.z0=z0;
-  surface_mesher(mesh,sphere.function,x0,y0,z0,r0,30,edge_length,edge_length);   
+  surface_mesher(mesh,sphere,x0,y0,z0,r0,30,edge_length,edge_length);   
 
 }
 
@@ -3418,6 +3896,7 @@ inline void Surface::make_sphere( double x0, double y0, double  z0,double r0, do
  */
 inline void Surface::split_edges(double  target_edge_length)
 {
+    invalidate_caches();
     assert_non_empty_mesh();
     
     CGAL::Polygon_mesh_processing::split_long_edges(edges(mesh), target_edge_length,mesh);
@@ -3461,6 +3940,7 @@ inline void Surface::save(const std::string outpath)
  */
 inline void Surface::reconstruct( double angular_bound, double radius_bound, double distance_bound )
 { 
+    invalidate_caches();
     assert_non_empty_mesh();
 
     poisson_reconstruction(*this,angular_bound, radius_bound, distance_bound);
@@ -0,0 +1,208 @@
+// Copyright (C) 2018-2021 Lars Magnus Valnes
+//
+// This file is part of Surface Volume Meshing Toolkit (SVM-TK).
+//
+// SVM-Tk is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SVM-Tk is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SVM-Tk.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef XDMF_H
+
+#define XDMF_H
+/* --- Includes -- */
+#include "Errors.h"
+#include "Medit.h"
+
+/* -- STL -- */
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/* -- HDF5 -- */
+#ifdef SVMTK_WITH_HDF5
+#include <hdf5.h>
+#endif
+
+/**
+ * \struct
+ *
+ * @brief Options for the HDF5 datasets written by write_xdmf.
+ */
+struct Xdmf_options
+{
+      int compression_level = 0;          // gzip level 0-9, 0 is no compression
+      std::size_t chunk_size = 0;         // rows per chunk, 0 is contiguous unless compressed
+      bool include_interior_facets = false; // write facets with tag 0 to the boundaries grid
+};
+
+/**
+ * @brief Returns true if SVMTK is compiled with HDF5, and XDMF export is available.
+ * @param none
+ * @return true if XDMF export is available.
+ */
+inline bool has_xdmf_support()
+{
+#ifdef SVMTK_WITH_HDF5
+   return true;
+#else
+   return false;
+#endif
+}
+
+#ifdef SVMTK_WITH_HDF5
+/**
+ * @brief Writes a two dimensional dataset to an open HDF5 file.
+ * @param file the HDF5 file identifier.
+ * @param name the name of the dataset.
+ * @param type the HDF5 memory and file type.
+ * @param data the row major data.
+ * @param rows the number of rows.
+ * @param columns the number of columns.
+ * @param options chunking and compression.
+ * @return void
+ * @throws AlgorithmError if HDF5 fails.
+ */
+inline void write_hdf5_dataset_(hid_t file, const std::string& name, hid_t type, const void* data,
+                                std::size_t rows, std::size_t columns, const Xdmf_options& options)
+{
+   hsize_t dims[2] = { static_cast<hsize_t>(rows), static_cast<hsize_t>(columns) };
+   hid_t space = H5Screate_simple(2, dims, nullptr);
+   hid_t plist = H5Pcreate(H5P_DATASET_CREATE);
+
+   std::size_t chunk_size = options.chunk_size;
+   if ( chunk_size == 0 and options.compression_level > 0 )
+      chunk_size = 65536;
+   if ( chunk_size > 0 and rows > 0 )
+   {
+      hsize_t chunk[2] = { static_cast<hsize_t>(std::min(chunk_size, rows)), static_cast<hsize_t>(columns) };
+      H5Pset_chunk(plist, 2, chunk);
+      if ( options.compression_level > 0 and H5Zfilter_avail(H5Z_FILTER_DEFLATE) > 0 )
+      {
+         H5Pset_shuffle(plist);
+         H5Pset_deflate(plist, static_cast<unsigned>(std::min(options.compression_level, 9)));
+      }
+   }
+
+   hid_t dataset = H5Dcreate2(file, name.c_str(), type, space, H5P_DEFAULT, plist, H5P_DEFAULT);
+   herr_t status = dataset < 0 ? -1 : 0;
+   if ( status >= 0 and rows > 0 )
+      status = H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+   if ( dataset >= 0 )
+      H5Dclose(dataset);
+   H5Pclose(plist);
+   H5Sclose(space);
+   if ( status < 0 )
+      throw AlgorithmError("Failed to write HDF5 dataset.");
+}
+#endif
+
+/**
+ * @brief Writes a mesh to XDMF, with the heavy data in a HDF5 file next to the XDMF file.
+ *
+ * The XDMF file contains two grids that share the coordinates:
+ * - "mesh" with the tetrahedra and the cell attribute "subdomains",
+ * - "boundaries" with the triangles and the cell attribute "boundaries".
+ * The HDF5 file has the same path with the extension .h5, and the datasets
+ * /mesh/coordinates, /mesh/topology, /mesh/subdomains, /boundaries/topology
+ * and /boundaries/boundaries.
+ *
+ * @param path the path to the XDMF file.
+ * @param mesh the mesh with tags.
+ * @param options chunking, compression and facet selection.
+ * @return void
+ * @throws PreconditionError if SVMTK is compiled without HDF5.
+ */
+inline void write_xdmf(const std::string& path, const Medit_mesh& mesh, const Xdmf_options& options = Xdmf_options())
+{
+#ifndef SVMTK_WITH_HDF5
+   throw PreconditionError("SVMTK is compiled without HDF5, XDMF export is not available.");
+#else
+   std::string::size_type dot = path.find_last_of(".");
+   std::string h5path = ( dot == std::string::npos ? path : path.substr(0, dot) ) + ".h5";
+   std::string::size_type slash = h5path.find_last_of("/");
+   std::string h5name = ( slash == std::string::npos ? h5path : h5path.substr(slash+1) );
+
+   std::vector<int> triangles;
+   std::vector<int> triangle_tags;
+   if ( options.include_interior_facets )
+   {
+      triangles = mesh.triangles;
+      triangle_tags = mesh.triangle_tags;
+   }
+   else
+   {
+      for ( std::size_t i = 0; i < mesh.number_of_triangles(); ++i )
+      {
+         if ( mesh.triangle_tags[i] == 0 )
+            continue;
+         triangles.insert(triangles.end(), mesh.triangles.begin()+3*i, mesh.triangles.begin()+3*i+3);
+         triangle_tags.push_back(mesh.triangle_tags[i]);
+      }
+   }
+
+   hid_t file = H5Fcreate(h5path.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+   if ( file < 0 )
+      throw InvalidArgumentError("Could not open HDF5 file for writing.");
+   try
+   {
+      for ( const char* group : {"/mesh", "/boundaries"} )
+         H5Gclose(H5Gcreate2(file, group, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT));
+      write_hdf5_dataset_(file, "/mesh/coordinates", H5T_NATIVE_DOUBLE, mesh.vertices.data(), mesh.number_of_vertices(), 3, options);
+      write_hdf5_dataset_(file, "/mesh/topology", H5T_NATIVE_INT, mesh.tetrahedra.data(), mesh.number_of_tetrahedra(), 4, options);
+      write_hdf5_dataset_(file, "/mesh/subdomains", H5T_NATIVE_INT, mesh.tetrahedron_tags.data(), mesh.number_of_tetrahedra(), 1, options);
+      write_hdf5_dataset_(file, "/boundaries/topology", H5T_NATIVE_INT, triangles.data(), triangle_tags.size(), 3, options);
+      write_hdf5_dataset_(file, "/boundaries/boundaries", H5T_NATIVE_INT, triangle_tags.data(), triangle_tags.size(), 1, options);
+   }
+   catch (...)
+   {
+      H5Fclose(file);
+      throw;
+   }
+   H5Fclose(file);
+
+   const std::size_t nv = mesh.number_of_vertices();
+   const std::size_t nc = mesh.number_of_tetrahedra();
+   const std::size_t nf = triangle_tags.size();
+   std::ofstream os(path);
+   if ( !os )
+      throw InvalidArgumentError("Could not open XDMF file for writing.");
+   os << "<?xml version=\"1.0\"?>\n"
+      << "<Xdmf Version=\"3.0\" xmlns:xi=\"http://www.w3.org/2001/XInclude\">\n"
+      << "  <Domain>\n"
+      << "    <Grid Name=\"mesh\" GridType=\"Uniform\">\n"
+      << "      <Topology TopologyType=\"Tetrahedron\" NumberOfElements=\"" << nc << "\" NodesPerElement=\"4\">\n"
+      << "        <DataItem Dimensions=\"" << nc << " 4\" NumberType=\"Int\" Precision=\"4\" Format=\"HDF\">" << h5name << ":/mesh/topology</DataItem>\n"
+      << "      </Topology>\n"
+      << "      <Geometry GeometryType=\"XYZ\">\n"
+      << "        <DataItem Dimensions=\"" << nv << " 3\" NumberType=\"Float\" Precision=\"8\" Format=\"HDF\">" << h5name << ":/mesh/coordinates</DataItem>\n"
+      << "      </Geometry>\n"
+      << "      <Attribute Name=\"subdomains\" AttributeType=\"Scalar\" Center=\"Cell\">\n"
+      << "        <DataItem Dimensions=\"" << nc << " 1\" NumberType=\"Int\" Precision=\"4\" Format=\"HDF\">" << h5name << ":/mesh/subdomains</DataItem>\n"
+      << "      </Attribute>\n"
+      << "    </Grid>\n"
+      << "    <Grid Name=\"boundaries\" GridType=\"Uniform\">\n"
+      << "      <Topology TopologyType=\"Triangle\" NumberOfElements=\"" << nf << "\" NodesPerElement=\"3\">\n"
+      << "        <DataItem Dimensions=\"" << nf << " 3\" NumberType=\"Int\" Precision=\"4\" Format=\"HDF\">" << h5name << ":/boundaries/topology</DataItem>\n"
+      << "      </Topology>\n"
+      << "      <Geometry GeometryType=\"XYZ\">\n"
+      << "        <DataItem Dimensions=\"" << nv << " 3\" NumberType=\"Float\" Precision=\"8\" Format=\"HDF\">" << h5name << ":/mesh/coordinates</DataItem>\n"
+      << "      </Geometry>\n"
+      << "      <Attribute Name=\"boundaries\" AttributeType=\"Scalar\" Center=\"Cell\">\n"
+      << "        <DataItem Dimensions=\"" << nf << " 1\" NumberType=\"Int\" Precision=\"4\" Format=\"HDF\">" << h5name << ":/boundaries/boundaries</DataItem>\n"
+      << "      </Attribute>\n"
+      << "    </Grid>\n"
+      << "  </Domain>\n"
+      << "</Xdmf>\n";
+#endif
+}
+
+#endif
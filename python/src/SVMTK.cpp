@@ -10,6 +10,7 @@
 #include "Surface.h"
 #include "Domain.h"
 #include "Slice.h"
+#include "Batch_meshing.h"
 
 
 namespace py = pybind11;
@@ -194,6 +195,13 @@ PYBIND11_MODULE(SVMTK, m) {
         .def("erase", &SubdomainMap::erase)
         .def("get_map", &SubdomainMap::get_map)
         .def("get_tags", &SubdomainMap::get_tags) 
+        .def("freeze", &SubdomainMap::freeze, py::arg("number_of_surfaces")=0)
+        .def("is_frozen", &SubdomainMap::is_frozen)
+        .def("index", [](const SubdomainMap& self, std::string bitstring)
+         {
+            std::reverse(bitstring.begin(), bitstring.end());
+            return self.index(SubdomainMap::Bmask(bitstring));
+         })
         .def("add", &SubdomainMap::add);
        
 
@@ -207,8 +215,8 @@ PYBIND11_MODULE(SVMTK, m) {
         .def("save", &Slice::save)
         .def("slice_surfaces", &Slice::slice_surfaces<Surface> ) 
         .def("as_surface", &Slice::as_surface<Surface>  ) 
-        .def("add_surface_domains", py::overload_cast<std::vector<Surface>, AbstractMap&>( &Slice::add_surface_domains<Surface> ) ) 
-        .def("add_surface_domains", py::overload_cast<std::vector<Surface>>( &Slice::add_surface_domains<Surface> ) ) 
+        .def("add_surface_domains", py::overload_cast<const std::vector<Surface>&, AbstractMap&>( &Slice::add_surface_domains<Surface> ) ) 
+        .def("add_surface_domains", py::overload_cast<const std::vector<Surface>&>( &Slice::add_surface_domains<Surface> ) ) 
         .def("number_of_constraints",&Slice::number_of_constraints)
         .def("number_of_subdomains",&Slice::number_of_subdomains)
         .def("number_of_faces",&Slice::number_of_faces)
@@ -277,8 +285,52 @@ PYBIND11_MODULE(SVMTK, m) {
         .def("make_circle_in_plane",  py::overload_cast<Point_3,Vector_3,double,double>(&Surface::make_circle_in_plane))
         
         .def("does_bound_volume", &Surface::does_bound_a_volume)
-        .def("is_point_inside", &Surface::is_point_inside)
+        .def("is_point_inside", py::overload_cast<Point_3>(&Surface::is_point_inside))
+        .def("is_point_inside", [](Surface& self, py::array_t<double, py::array::c_style | py::array::forcecast> points)
+                                {
+                                   if ( points.ndim() != 2 or points.shape(1) != 3 )
+                                      throw InvalidArgumentError("Points must be an array with shape (N,3).");
+                                   const std::size_t n = points.shape(0);
+                                   py::array_t<bool> inside(n);
+                                   const double* coordinates = points.data();
+                                   bool* result = inside.mutable_data();
+                                   {
+                                      py::gil_scoped_release release;
+                                      self.is_point_inside(coordinates, n, result);
+                                   }
+                                   return inside;
+                                }, py::arg("points"))
         .def("get_closest_points", &Surface::get_closest_points, py::arg("p1"),py::arg("num")=8)
+        .def("get_closest_vertices", [](const Surface& self, py::array_t<double, py::array::c_style | py::array::forcecast> points, int k)
+                                     {
+                                        if ( points.ndim() != 2 or points.shape(1) != 3 )
+                                           throw InvalidArgumentError("Points must be an array with shape (N,3).");
+                                        const std::size_t n = points.shape(0);
+                                        py::array_t<std::int64_t> indices({n, static_cast<std::size_t>(std::max(k,0))});
+                                        py::array_t<double> distances({n, static_cast<std::size_t>(std::max(k,0))});
+                                        const double* coordinates = points.data();
+                                        std::int64_t* indices_data = indices.mutable_data();
+                                        double* distances_data = distances.mutable_data();
+                                        {
+                                           py::gil_scoped_release release;
+                                           self.get_closest_vertices(coordinates, n, k, indices_data, distances_data);
+                                        }
+                                        return std::make_pair(indices, distances);
+                                     }, py::arg("points"), py::arg("k")=1)
+        .def("get_vertices_within_radius", [](const Surface& self, py::array_t<double, py::array::c_style | py::array::forcecast> points, double radius)
+                                     {
+                                        if ( points.ndim() != 2 or points.shape(1) != 3 )
+                                           throw InvalidArgumentError("Points must be an array with shape (N,3).");
+                                        const std::size_t n = points.shape(0);
+                                        const double* coordinates = points.data();
+                                        std::vector<std::int64_t> offsets, indices;
+                                        {
+                                           py::gil_scoped_release release;
+                                           self.get_vertices_within_radius(coordinates, n, radius, offsets, indices);
+                                        }
+                                        return std::make_pair(py::array_t<std::int64_t>(offsets.size(), offsets.data()),
+                                                              py::array_t<std::int64_t>(indices.size(), indices.data()));
+                                     }, py::arg("points"), py::arg("radius"))
 
         .def("mean_curvature_flow", &Surface::mean_curvature_flow)
         .def("get_shortest_surface_path", py::overload_cast<double , double, double , double,double,double>( &Surface::get_shortest_surface_path) )
@@ -286,6 +338,7 @@ PYBIND11_MODULE(SVMTK, m) {
 
         .def("embed", &Surface::embed, py::arg("other") , py::arg("adjustment")=-0.8,py::arg("smoothing")=0.4, py::arg("max_iter")=400)
         .def("enclose", &Surface::enclose,py::arg("other") , py::arg("adjustment")=0.8,py::arg("smoothing")=-0.4, py::arg("max_iter")=400)
+        .def("get_vertex_selection_report", &Surface::get_vertex_selection_report)
         .def("separate", &Surface::separate, py::arg("other") , py::arg("adjustment")=0.8, py::arg("max_iter")=400)
 
 
@@ -310,37 +363,96 @@ PYBIND11_MODULE(SVMTK, m) {
         .def("num_self_intersections", &Surface::num_self_intersections) 
         .def("num_vertices", &Surface::num_vertices)
         .def("distance", &Surface::distance_to_point) 
+        .def("signed_distance", &Surface::signed_distance_to_point) 
+        .def("signed_distance_field", [](const Surface& self, std::array<double,3> origin, std::array<double,3> spacing, std::array<int,3> dimensions, bool occupancy)
+                                      {
+                                         for ( int k = 0; k < 3; ++k )
+                                         {
+                                            if ( dimensions[k] <= 0 )
+                                               throw InvalidArgumentError("Grid dimensions and spacing must be positive.");
+                                         }
+                                         py::array_t<float> values({static_cast<std::size_t>(dimensions[2]), static_cast<std::size_t>(dimensions[1]), static_cast<std::size_t>(dimensions[0])});
+                                         float* data = values.mutable_data();
+                                         {
+                                            py::gil_scoped_release release;
+                                            self.signed_distance_field(origin, spacing, dimensions, data, occupancy);
+                                         }
+                                         return values;
+                                      }, py::arg("origin"), py::arg("spacing"), py::arg("dimensions"), py::arg("occupancy")=false)
+        .def("save_signed_distance_field", &Surface::save_signed_distance_field, py::arg("path"), py::arg("origin"), py::arg("spacing"),
+                                           py::arg("dimensions"), py::arg("occupancy")=false, py::call_guard<py::gil_scoped_release>())
+        .def("distance_to_points", [](const Surface& self, py::array_t<double, py::array::c_style | py::array::forcecast> points, bool use_sign)
+                                   {
+                                      if ( points.ndim() != 2 or points.shape(1) != 3 )
+                                         throw InvalidArgumentError("Points must be an array with shape (N,3).");
+                                      const std::size_t n = points.shape(0);
+                                      py::array_t<double> distances(n);
+                                      py::array_t<double> closest_points({n, std::size_t(3)});
+                                      py::array_t<std::int64_t> closest_faces(n);
+                                      const double* coordinates = points.data();
+                                      double* distances_data = distances.mutable_data();
+                                      double* closest_points_data = closest_points.mutable_data();
+                                      std::int64_t* closest_faces_data = closest_faces.mutable_data();
+                                      {
+                                         py::gil_scoped_release release;
+                                         self.distance_to_points(coordinates, n, use_sign, distances_data, closest_points_data, closest_faces_data);
+                                      }
+                                      return py::make_tuple(distances, closest_points, closest_faces);
+                                   }, py::arg("points"), py::arg("signed")=false)
         .def("centeroid", &Surface::centeroid)
         .def("area", &Surface::area)
         .def("volume", &Surface::volume);    
 
 
     py::class_<Domain,std::shared_ptr<Domain>>(m, "Domain")
-        .def(py::init<Surface &,double>(), py::arg("surface"), py::arg("error")=1.e-7)
-        .def(py::init<std::vector<Surface>,double>(),py::arg("surfaces"), py::arg("error")=1.e-7)
-        .def(py::init<std::vector<Surface>, std::shared_ptr<AbstractMap>,double>(), py::arg("surfaces"), py::arg("map"), py::arg("error")=1.e-7)
+        .def(py::init<const Surface &,double>(), py::arg("surface"), py::arg("error")=1.e-7)
+        .def(py::init<const std::vector<std::shared_ptr<Surface>>&,double>(),py::arg("surfaces"), py::arg("error")=1.e-7)
+        .def(py::init<const std::vector<std::shared_ptr<Surface>>&, std::shared_ptr<AbstractMap>,double>(), py::arg("surfaces"), py::arg("map"), py::arg("error")=1.e-7)
 
         .def("create_mesh", py::overload_cast<double,double,double,double,double,double>( &Domain::create_mesh), 
                             py::arg("edge_size"), py::arg("cell_size"), py::arg("facet_size"),
-                            py::arg("facet_angle"),py::arg("facet_distance"), py::arg("cell_radius_edge_ratio") )  
-
-        .def("create_mesh", py::overload_cast<double>(&Domain::create_mesh))
+                            py::arg("facet_angle"),py::arg("facet_distance"), py::arg("cell_radius_edge_ratio"),
+                            py::call_guard<py::gil_scoped_release>() )  
+
+        .def("create_mesh", py::overload_cast<double>(&Domain::create_mesh), py::call_guard<py::gil_scoped_release>())
+        .def("refine", py::overload_cast<double,double,double,double,double,double>( &Domain::refine), 
+                       py::arg("edge_size"), py::arg("cell_size"), py::arg("facet_size"),
+                       py::arg("facet_angle"),py::arg("facet_distance"), py::arg("cell_radius_edge_ratio"),
+                       py::call_guard<py::gil_scoped_release>() )  
+        .def("refine", py::overload_cast<double>(&Domain::refine), py::arg("mesh_resolution"), py::call_guard<py::gil_scoped_release>())
+        .def("set_number_of_threads", &Domain::set_number_of_threads, py::arg("number_of_threads"))
+        .def("get_number_of_threads", &Domain::get_number_of_threads)
+        .def("enable_oracle_statistics", &Domain::enable_oracle_statistics, py::arg("enable")=true)
+        .def("get_oracle_statistics", &Domain::get_oracle_statistics)
+        .def("set_subdomain_size", &Domain::set_subdomain_size, py::arg("tag"), py::arg("cell_size"))
+        .def("set_interface_size", &Domain::set_interface_size, py::arg("interface"), py::arg("facet_size"))
+        .def("set_curve_size", &Domain::set_curve_size, py::arg("tag"), py::arg("edge_size"))
+        .def("clear_sizes", &Domain::clear_sizes)
+        .def("get_sizing_report", &Domain::get_sizing_report)
         .def("radius_ratio_min_max", &Domain::radius_ratio_min_max)
         .def("dihedral_angles_min_max", &Domain::dihedral_angles_min_max)
         .def("radius_ratio", &Domain::radius_ratio)
-        .def("dihedral_angles", &Domain::dihedral_angles)       
+        .def("dihedral_angles", &Domain::dihedral_angles)
+        .def("quality_report", &Domain::quality_report, py::arg("number_of_bins")=10, 
+                               py::arg("percentiles")=std::vector<double>{1,5,25,50,75,95,99}, py::arg("number_of_worst_cells")=10)       
 
         .def("get_boundary", &Domain::get_boundary<Surface>, py::arg("tag")=0)
         .def("get_boundaries", &Domain::get_boundaries<Surface>)
+        .def("get_interface", &Domain::get_interface<Surface>, py::arg("interface"))
         .def("get_borders", &Domain::get_borders)
         .def("get_curves", &Domain::get_curves)
         .def("get_patches", &Domain::get_patches)
         .def("get_subdomains", &Domain::get_subdomains)
+        .def("get_subdomain_cell_counts", &Domain::get_subdomain_cell_counts)
+        .def("get_isolated_vertices_report", &Domain::get_isolated_vertices_report)
+        .def("remove_isolated_vertices", &Domain::remove_isolated_vertices)
 
         .def("lloyd", &Domain::lloyd,     py::arg("time_limit")=0, py::arg("max_iteration_number")=0, py::arg("convergence")=0.02, py::arg("freeze_bound")=0.01,py::arg("do_freeze")=true)
         .def("odt", &Domain::odt,         py::arg("time_limit")=0, py::arg("max_iteration_number")=0, py::arg("convergence")=0.02, py::arg("freeze_bound")=0.01,py::arg("do_freeze")=true)
         .def("exude", &Domain::exude,     py::arg("time_limit")=0, py::arg("sliver_bound")=0)
         .def("perturb", &Domain::perturb, py::arg("time_limit")=0, py::arg("sliver_bound")=0)
+        .def("optimize", &Domain::optimize, py::arg("stages")=std::vector<std::string>{"odt","perturb","exude"}, py::arg("time_budget")=0,
+                                            py::arg("min_dihedral_angle")=0, py::arg("min_radius_ratio")=0, py::call_guard<py::gil_scoped_release>())
 
         .def("add_sharp_border_edges", py::overload_cast<Surface&,double>( &Domain::add_sharp_border_edges<Surface>), py::arg("surface") , py::arg("threshold")=60 )
         .def("add_sharp_border_edges", py::overload_cast<Surface&, Plane_3>( &Domain::add_sharp_border_edges<Surface,Plane_3>),py::arg("surface"), py::arg("plane"))
@@ -362,11 +474,81 @@ PYBIND11_MODULE(SVMTK, m) {
         .def("boundary_segmentations",py::overload_cast<std::pair<int,int>,double>(&Domain::boundary_segmentations<Surface> ),py::arg("interface"),py::arg("angle_in_degree")=85 )
         .def("add_feature", &Domain::add_feature) 
         .def("add_border", &Domain::add_border)
-        .def("save", &Domain::save, py::arg("OutPath"), py::arg("save_1Dfeatures")=true); 
+        .def("export_mesh", &Domain::export_mesh, py::arg("save_1Dfeatures")=true)
+        .def("save_checkpoint", &Domain::save_checkpoint, py::arg("OutPath"))
+        .def("load_checkpoint", &Domain::load_checkpoint, py::arg("InPath"))
+        .def("save_xdmf", &Domain::save_xdmf, py::arg("OutPath"), py::arg("compression_level")=0, py::arg("chunk_size")=0, py::arg("include_interior_facets")=false)
+        .def("save", &Domain::save, py::arg("OutPath"), py::arg("save_1Dfeatures")=true, py::arg("binary_version")=3); 
+
+    py::class_<Quality_report,std::shared_ptr<Quality_report>>(m, "QualityReport")
+        .def_static("metric_names", &Quality_report::metric_names)
+        .def("number_of_cells", &Quality_report::number_of_cells)
+        // The arrays are views of the report data, and keep the report alive.
+        .def("values", [](py::object self, std::string name) 
+                       { 
+                          const std::vector<double>& values = self.cast<Quality_report&>().get_values(name);
+                          return py::array_t<double>(values.size(), values.data(), self);
+                       }, py::arg("metric"))
+        .def("subdomains", [](py::object self) 
+                       { 
+                          const std::vector<int>& subdomains = self.cast<Quality_report&>().subdomains;
+                          return py::array_t<int>(subdomains.size(), subdomains.data(), self);
+                       })
+        .def_readonly("percentiles", &Quality_report::percentiles)
+        .def_readonly("histogram_edges", &Quality_report::histogram_edges)
+        .def_readonly("histograms", &Quality_report::histograms)
+        .def_readonly("percentile_values", &Quality_report::percentile_values)
+        .def_readonly("worst_cells", &Quality_report::worst_cells);
+
+    py::class_<Medit_mesh,std::shared_ptr<Medit_mesh>>(m, "MeditMesh")
+        .def(py::init<>())
+        .def_readwrite("vertices", &Medit_mesh::vertices)
+        .def_readwrite("vertex_tags", &Medit_mesh::vertex_tags)
+        .def_readwrite("edges", &Medit_mesh::edges)
+        .def_readwrite("edge_tags", &Medit_mesh::edge_tags)
+        .def_readwrite("triangles", &Medit_mesh::triangles)
+        .def_readwrite("triangle_tags", &Medit_mesh::triangle_tags)
+        .def_readwrite("tetrahedra", &Medit_mesh::tetrahedra)
+        .def_readwrite("tetrahedron_tags", &Medit_mesh::tetrahedron_tags)
+        .def("number_of_vertices", &Medit_mesh::number_of_vertices)
+        .def("number_of_edges", &Medit_mesh::number_of_edges)
+        .def("number_of_triangles", &Medit_mesh::number_of_triangles)
+        .def("number_of_tetrahedra", &Medit_mesh::number_of_tetrahedra);
+
+    py::class_<Meshing_job>(m, "MeshingJob")
+        .def(py::init<>())
+        .def_readwrite("surfaces", &Meshing_job::surfaces)
+        .def_readwrite("surface_files", &Meshing_job::surface_files)
+        .def_readwrite("map", &Meshing_job::map)
+        .def_readwrite("mesh_resolution", &Meshing_job::mesh_resolution)
+        .def_readwrite("edge_size", &Meshing_job::edge_size)
+        .def_readwrite("cell_size", &Meshing_job::cell_size)
+        .def_readwrite("facet_size", &Meshing_job::facet_size)
+        .def_readwrite("facet_angle", &Meshing_job::facet_angle)
+        .def_readwrite("facet_distance", &Meshing_job::facet_distance)
+        .def_readwrite("cell_radius_edge_ratio", &Meshing_job::cell_radius_edge_ratio)
+        .def_readwrite("optimization_stages", &Meshing_job::optimization_stages)
+        .def_readwrite("optimization_time_budget", &Meshing_job::optimization_time_budget)
+        .def_readwrite("output_path", &Meshing_job::output_path)
+        .def_readwrite("save_1Dfeatures", &Meshing_job::save_1Dfeatures)
+        .def_readwrite("memory_estimate", &Meshing_job::memory_estimate);
+
+    py::class_<Meshing_job_result>(m, "MeshingJobResult")
+        .def_readonly("status", &Meshing_job_result::status)
+        .def_readonly("error", &Meshing_job_result::error)
+        .def_readonly("number_of_cells", &Meshing_job_result::number_of_cells)
+        .def_readonly("memory_estimate", &Meshing_job_result::memory_estimate)
+        .def_readonly("timings", &Meshing_job_result::timings);
+
                   
 
 
        m.def("convex_hull", &Wrapper_convex_hull); 
+       m.def("read_medit", &read_medit, py::arg("path"));
+       m.def("has_xdmf_support", &has_xdmf_support);
+       m.def("run_meshing_jobs", &run_meshing_jobs, py::arg("jobs"), py::arg("number_of_workers")=1, py::arg("memory_limit")=0, 
+                                                    py::arg("threads_per_job")=1, py::call_guard<py::gil_scoped_release>());
+       m.def("write_medit_binary", &write_medit_binary, py::arg("path"), py::arg("mesh"), py::arg("version")=3);
        //TODO : Rename edge_movement.
        m.def("separate_overlapping_surfaces",  py::overload_cast<Surface&,Surface&,Surface&,double,double,int>( &separate_surface_overlapp<Surface>),
                                    py::arg("surf1"), py::arg("surf2"), py::arg("other"), 
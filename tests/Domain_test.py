@@ -1,10 +1,33 @@
 
 import unittest
+import os
+import tempfile
 import SVMTK
 
 
+def make_two_cubes():
+    surface_1 = SVMTK.Surface() 
+    surface_1.make_cube(-1.,-1.,-1.,1.,1.,1.,1) 
+    surface_2 = SVMTK.Surface() 
+    surface_2.make_cube(-2.,-2.,-2.,2.,2.,2.,1)
+    return surface_1, surface_2
+
+def make_two_cube_mesh():
+    domain = SVMTK.Domain(list(make_two_cubes()))
+    domain.create_mesh(1.) 
+    return domain
+
+
 class Domain_Test(unittest.TestCase):
 
+    def setUp(self):
+        directory = tempfile.TemporaryDirectory()
+        self.addCleanup(directory.cleanup)
+        self.directory = directory.name
+
+    def output(self, filename):
+        return os.path.join(self.directory, filename)
+
     def test_single_domain(self):
         surface_1 = SVMTK.Surface() 
         surface_1.make_cube(-1.,-1.,-1.,1.,1.,1.,1) 
@@ -108,6 +131,174 @@ class Domain_Test(unittest.TestCase):
 
     
     
+    def test_parallel_meshing(self):
+        surface_1, surface_2 = make_two_cubes()
+        sf= SVMTK.SubdomainMap()
+        sf.add("01",3) 
+        sf.add("11",2)        
+        domain = SVMTK.Domain([surface_1,surface_2],sf)
+        domain.set_number_of_threads(2)
+        self.assertEqual(domain.get_number_of_threads(),2)
+        domain.create_mesh(1.) 
+        self.assertTrue(domain.number_of_cells() >0) 
+        domain.lloyd()
+        domain.perturb()
+        domain.exude()
+        domain.remove_subdomain(2)
+        self.assertEqual(domain.number_of_subdomains(),1)
+        domain.save(self.output("parallel.mesh"))
+        with self.assertRaises(SVMTK.InvalidArgumentError):
+             domain.set_number_of_threads(-1)
+
+    def test_oracle_statistics(self):
+        surface_1, surface_2 = make_two_cubes()
+        domain = SVMTK.Domain([surface_1,surface_2])
+        domain.enable_oracle_statistics()
+        domain.create_mesh(1.) 
+        statistics = domain.get_oracle_statistics()
+        self.assertTrue(statistics["calls"] > 0)
+        self.assertTrue(statistics["bbox_rejections"] > 0)
+        self.assertEqual(statistics["ray_casts"] + statistics["bbox_rejections"], 2*statistics["calls"])
+
+    def test_save_binary(self):
+        domain = make_two_cube_mesh()
+        domain.save(self.output("binary.mesh"))
+        domain.save(self.output("binary.meshb"))
+        ascii_mesh = SVMTK.read_medit(self.output("binary.mesh"))
+        binary_mesh = SVMTK.read_medit(self.output("binary.meshb"))
+        self.assertEqual(binary_mesh.number_of_vertices(), domain.number_of_vertices())
+        self.assertEqual(binary_mesh.number_of_tetrahedra(), domain.number_of_cells())
+        self.assertEqual(binary_mesh.tetrahedra, ascii_mesh.tetrahedra)
+        self.assertEqual(binary_mesh.tetrahedron_tags, ascii_mesh.tetrahedron_tags)
+        self.assertEqual(binary_mesh.triangles, ascii_mesh.triangles)
+        self.assertEqual(binary_mesh.triangle_tags, ascii_mesh.triangle_tags)
+        self.assertEqual(binary_mesh.edges, ascii_mesh.edges)
+        self.assertEqual(binary_mesh.edge_tags, ascii_mesh.edge_tags)
+        self.assertEqual(binary_mesh.vertex_tags, ascii_mesh.vertex_tags)
+        for x,y in zip(binary_mesh.vertices, ascii_mesh.vertices):
+            self.assertAlmostEqual(x,y)
+        SVMTK.write_medit_binary(self.output("binary_v2.meshb"), binary_mesh, 2)
+        self.assertEqual(SVMTK.read_medit(self.output("binary_v2.meshb")).tetrahedra, binary_mesh.tetrahedra)
+
+    def test_export_mesh(self):
+        domain = make_two_cube_mesh()
+        mesh = domain.export_mesh()
+        self.assertEqual(mesh.number_of_vertices(), domain.number_of_vertices())
+        self.assertEqual(mesh.number_of_tetrahedra(), domain.number_of_cells())
+        self.assertEqual(len(mesh.tetrahedra), 4*mesh.number_of_tetrahedra())
+        self.assertEqual(len(set(zip(mesh.edges[::2], mesh.edges[1::2]))), mesh.number_of_edges())
+        self.assertEqual(len(set(mesh.tetrahedron_tags)), 2)
+        self.assertEqual(domain.export_mesh(False).number_of_edges(), 0)
+
+    def test_save_xdmf(self):
+        domain = make_two_cube_mesh()
+        if not SVMTK.has_xdmf_support():
+            with self.assertRaises(SVMTK.PreconditionError):
+                domain.save(self.output("xdmf.xdmf"))
+            return 
+        domain.save_xdmf(self.output("xdmf.xdmf"), compression_level=4)
+        self.assertTrue(os.path.isfile(self.output("xdmf.h5")))
+        import xml.etree.ElementTree as ET
+        grids = ET.parse(self.output("xdmf.xdmf")).getroot().findall("./Domain/Grid")
+        self.assertEqual([grid.get("Name") for grid in grids], ["mesh", "boundaries"]) 
+        self.assertEqual(int(grids[0].find("Topology").get("NumberOfElements")), domain.number_of_cells())
+        self.assertTrue(int(grids[1].find("Topology").get("NumberOfElements")) > 0)
+        with self.assertRaises(SVMTK.InvalidArgumentError):
+            domain.save_xdmf(self.output("xdmf.xdmf"), compression_level=10)
+
+    def test_checkpoint(self):
+        surface_1, surface_2 = make_two_cubes()
+        domain = SVMTK.Domain([surface_1,surface_2])
+        domain.add_sharp_border_edges(surface_1)
+        domain.create_mesh(1.) 
+        domain.save_checkpoint(self.output("checkpoint.bin"))
+
+        restored = SVMTK.Domain([surface_1,surface_2])
+        restored.load_checkpoint(self.output("checkpoint.bin"))
+        self.assertEqual(restored.number_of_cells(), domain.number_of_cells())
+        self.assertEqual(restored.number_of_vertices(), domain.number_of_vertices())
+        self.assertEqual(restored.number_of_subdomains(), domain.number_of_subdomains())
+        self.assertEqual(restored.number_of_patches(), domain.number_of_patches())
+        self.assertEqual(restored.number_of_curves(), domain.number_of_curves())
+        self.assertEqual(len(restored.get_borders()), len(domain.get_borders()))
+        restored.exude()
+        restored.remove_subdomain(3)
+        self.assertEqual(restored.number_of_subdomains(), 1)
+
+        with self.assertRaises(SVMTK.InvalidArgumentError):
+            SVMTK.Domain(surface_1).load_checkpoint(self.output("checkpoint.bin"))
+
+    def test_remove_subdomains(self):
+        surfaces = [] 
+        for r in [1.,2.,3.]:
+            surface = SVMTK.Surface() 
+            surface.make_cube(-r,-r,-r,r,r,r,1) 
+            surfaces.append(surface)
+        sf = SVMTK.SubdomainMap()
+        sf.add("111",1)
+        sf.add("011",2)
+        sf.add("001",3)
+        domain = SVMTK.Domain(surfaces,sf)
+        domain.create_mesh(1.) 
+        self.assertEqual(domain.number_of_subdomains(),3)
+        cells = domain.number_of_cells()
+        vertices = domain.number_of_vertices()
+        counts = domain.get_subdomain_cell_counts()
+        self.assertEqual(sorted(counts.keys()),[1,2,3])
+        self.assertEqual(sum(counts.values()),cells)
+        domain.remove_subdomain([1,3,5])
+        self.assertEqual(domain.get_subdomain_cell_counts(),{2:domain.number_of_cells()})
+        self.assertEqual(domain.number_of_subdomains(),1)
+        self.assertTrue(domain.number_of_cells() < cells)
+        self.assertTrue(domain.number_of_vertices() < vertices)
+        self.assertEqual(domain.get_subdomains(),{2})
+        domain.remove_subdomain([])
+        self.assertEqual(domain.number_of_subdomains(),1)
+
+    def test_isolated_vertices(self):
+        surface = SVMTK.Surface() 
+        surface.make_sphere(0.,0.,0.,3.,0.5) 
+        domain = SVMTK.Domain(surface)
+        domain.create_mesh(8.) 
+        report = domain.get_isolated_vertices_report()
+        self.assertEqual(report["complex_vertices"], domain.number_of_vertices())
+        self.assertEqual(report["isolated_vertices"], report["triangulation_vertices"] - report["complex_vertices"])
+        self.assertEqual(domain.export_mesh().number_of_vertices(), domain.number_of_vertices())
+        vertices = domain.number_of_vertices()
+        facets = domain.number_of_facets()
+        cells = domain.number_of_cells()
+        removed = domain.remove_isolated_vertices()
+        self.assertEqual(removed, report["isolated_vertices"])
+        self.assertEqual(domain.number_of_vertices(), vertices)
+        self.assertEqual(domain.number_of_facets(), facets)
+        self.assertEqual(domain.number_of_cells(), cells)
+        report = domain.get_isolated_vertices_report()
+        self.assertEqual(report["isolated_vertices"], 0)
+        self.assertEqual(report["removed_vertices"], removed)
+
+    def test_quality_report(self):
+        domain = make_two_cube_mesh()
+        report = domain.quality_report(number_of_bins=5, percentiles=[0,50,100], number_of_worst_cells=3)
+        n = domain.number_of_cells()
+        self.assertEqual(report.number_of_cells(), n)
+        radius_ratio = report.values("radius_ratio")
+        self.assertEqual(radius_ratio.shape, (n,))
+        self.assertFalse(radius_ratio.flags.owndata)
+        self.assertAlmostEqual(radius_ratio.min(), domain.radius_ratio_min_max()[0], 6)
+        self.assertTrue((report.values("volume") > 0).all())
+        self.assertTrue((report.values("min_dihedral_angle") <= report.values("max_dihedral_angle")).all())
+        counts = domain.get_subdomain_cell_counts()
+        for tag, histogram in report.histograms["aspect_ratio"].items():
+            self.assertEqual(len(histogram), 5)
+            self.assertEqual(sum(histogram), counts[tag])
+            self.assertEqual(len(report.percentile_values["aspect_ratio"][tag]), 3)
+        self.assertEqual(set(report.subdomains()), set(counts.keys()))
+        worst = report.worst_cells["radius_ratio"]
+        self.assertEqual(len(worst), 3)
+        self.assertAlmostEqual(radius_ratio[worst[0]], radius_ratio.min())
+        with self.assertRaises(SVMTK.InvalidArgumentError):
+            report.values("unknown")
+
     def test_surface_segmentation(self): # NOTE: may occasionally fail.
         surface_1 = SVMTK.Surface() 
         surface_1.make_cube(0,0,0,1.,1.,1.,1) 
@@ -133,13 +324,135 @@ class Domain_Test(unittest.TestCase):
         domain.boundary_segmentations()
 
         self.assertTrue(domain.number_of_patches()==9)       
-        
 
+    def test_refine(self):
+        surface = SVMTK.Surface() 
+        surface.make_cube(-1.,-1.,-1.,1.,1.,1.,1) 
+        domain = SVMTK.Domain(surface)
+        domain.add_sharp_border_edges(surface, 85)
+        domain.create_mesh(1.) 
+        cells = domain.number_of_cells()
+        curves = domain.number_of_curves()
+        domain.refine(4.)
+        self.assertTrue(domain.number_of_cells() > cells)
+        self.assertEqual(domain.number_of_curves(), curves)
+        self.assertEqual(domain.export_mesh().number_of_vertices(), domain.number_of_vertices())
+        with self.assertRaises(SVMTK.EmptyMeshError):
+            SVMTK.Domain(surface).refine(4.)
 
+    def test_subdomain_sizes(self):
+        domain = make_two_cube_mesh()
+        uniform = domain.get_subdomain_cell_counts()
+        self.assertEqual(domain.get_sizing_report()["estimated_savings"], 0)
+        domain.set_subdomain_size(3, 0.25)
+        domain.create_mesh(1.) 
+        sized = domain.get_subdomain_cell_counts()
+        self.assertTrue(sized[3] > uniform[3])
+        report = domain.get_sizing_report()
+        self.assertEqual(report["cells"], domain.number_of_cells())
+        self.assertEqual(report["minimum_cell_size"], 0.25)
+        self.assertTrue(report["estimated_uniform_cells"] > report["cells"])
+        self.assertTrue(0 < report["estimated_savings"] < 1)
+        with self.assertRaises(SVMTK.InvalidArgumentError):
+            domain.set_subdomain_size(1, 0.)
+        domain.clear_sizes()
 
-if __name__ == '__main__':
-    unittest.main()
+    def test_unbounded_criteria(self):
+        surface_1, surface_2 = make_two_cubes()
+        domain = SVMTK.Domain([surface_1,surface_2])
+        domain.create_mesh(edge_size=0, cell_size=0.5, facet_size=0, facet_angle=30, facet_distance=0.1, cell_radius_edge_ratio=3)
+        self.assertTrue(domain.number_of_cells() > 0)
+        domain.set_subdomain_size(1, 0.25)
+        domain.create_mesh(edge_size=0, cell_size=0.5, facet_size=0, facet_angle=30, facet_distance=0.1, cell_radius_edge_ratio=3)
+        self.assertTrue(domain.number_of_cells() > 0)
+
+    def test_sharp_border_edges(self):
+        surface_1 = SVMTK.Surface() 
+        surface_1.make_cube(0.,0.,0.,1.,1.,1.,1) 
+        surface_2 = SVMTK.Surface() 
+        surface_2.make_cube(0.,0.,0.,1.,1.,1.,1) 
+        domain = SVMTK.Domain(surface_1)
+        domain.add_sharp_border_edges(surface_1, 85)
+        borders = len(domain.get_borders())
+        self.assertTrue(borders > 0)
+        domain.add_sharp_border_edges(surface_2, 85)
+        self.assertEqual(len(domain.get_borders()), borders)
+        domain.clear_borders()
+        domain.add_sharp_border_edges(surface_2, 85)
+        self.assertEqual(len(domain.get_borders()), borders)
 
+    def test_get_boundaries(self):
+        domain = make_two_cube_mesh()
+        patches = domain.get_patches()
+        surfaces = domain.get_boundaries()
+        self.assertEqual(len(surfaces), len(patches))
+        for patch, surface in zip(patches, surfaces):
+            interface = domain.get_interface(patch)
+            self.assertEqual(surface.num_faces(), interface.num_faces())
+            self.assertEqual(surface.num_vertices(), interface.num_vertices())
+        self.assertEqual(sum(surface.num_faces() for surface in surfaces), domain.number_of_facets())
 
+    def test_interface_segmentation(self):
+        surface_1, surface_2 = make_two_cubes()
+        domain = SVMTK.Domain([surface_1,surface_2])
+        domain.add_sharp_border_edges(surface_1,85)
+        domain.create_mesh(1.) 
+        facets = domain.number_of_facets()
+        interface = [patch for patch in domain.get_patches() if 0 not in patch][0]
+        domain.boundary_segmentations(interface, 85)
+        self.assertTrue(interface not in domain.get_patches())
+        self.assertTrue(domain.number_of_patches() > 2)
+        self.assertEqual(domain.number_of_facets(), facets)
+        self.assertFalse(os.path.exists("jfam.off"))
 
+    def test_optimize(self):
+        surface = SVMTK.Surface() 
+        surface.make_sphere(0.,0.,0.,3.,1.) 
+        domain = SVMTK.Domain(surface)
+        domain.create_mesh(8.) 
+        reports = domain.optimize(["exude","odt"], time_budget=60)
+        self.assertEqual([stage for stage, report in reports], ["odt","exude"])
+        for stage, report in reports:
+            self.assertAlmostEqual(report["min_dihedral_angle_delta"], report["min_dihedral_angle_after"]-report["min_dihedral_angle_before"])
+            self.assertTrue(report["time"] <= 60)
+        self.assertEqual(domain.optimize(["perturb"], min_dihedral_angle=1.e-6, min_radius_ratio=1.e-6), [])
+        with self.assertRaises(Exception):
+            domain.optimize(["smooth"])
 
+    def test_run_meshing_jobs(self):
+        jobs = []
+        for radius in [1.,2.]:
+            surface = SVMTK.Surface() 
+            surface.make_cube(-radius,-radius,-radius,radius,radius,radius,1) 
+            job = SVMTK.MeshingJob()
+            job.surfaces = [surface]
+            job.mesh_resolution = 1.
+            job.optimization_stages = ["odt"]
+            job.output_path = self.output("batch_{}.mesh".format(int(radius)))
+            jobs.append(job)
+        failing = SVMTK.MeshingJob()
+        failing.surface_files = [self.output("missing.off")]
+        failing.mesh_resolution = 1.
+        jobs.append(failing)
+        results = SVMTK.run_meshing_jobs(jobs, number_of_workers=2, memory_limit=1.)
+        self.assertEqual([result.status for result in results], ["done","done","failed"])
+        for job, result in zip(jobs[:2], results):
+            self.assertTrue(os.path.isfile(job.output_path))
+            self.assertEqual(SVMTK.read_medit(job.output_path).number_of_tetrahedra(), result.number_of_cells)
+            self.assertTrue(result.timings["total"] >= result.timings["mesh"])
+        self.assertTrue(len(results[2].error) > 0)
+
+    def test_domain_owns_surface_mesh(self):
+        surface_1, surface_2 = make_two_cubes()
+        domain = SVMTK.Domain([surface_1,surface_2])
+        surface_1.clear()
+        surface_2.clear()
+        domain.create_mesh(1.) 
+        self.assertTrue(domain.number_of_cells() > 0)
+        self.assertEqual(domain.number_of_subdomains(), 2)
+        
+
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -83,6 +83,60 @@ class SubdomainMap_Test(unittest.TestCase):
         self.assertTrue(flag)     
              
              
+    def test_freeze(self):
+        smap = SVMTK.SubdomainMap(2) 
+        smap.add("01",2)
+        smap.add("11",3)
+        smap.freeze()
+        self.assertTrue(smap.is_frozen())
+        self.assertEqual(smap.index("01"),2)
+        self.assertEqual(smap.index("11"),3)
+        self.assertEqual(smap.index("10"),0)
+        smap.add("10",4)
+        self.assertFalse(smap.is_frozen())
+        self.assertEqual(smap.index("10"),4)
+
+    def test_freeze_many_surfaces(self):
+        n = 25
+        smap = SVMTK.SubdomainMap(n) 
+        for i in range(n):
+            bitstring = ["0"]*n
+            bitstring[i] = "1" 
+            smap.add("".join(bitstring), i+1)
+        smap.freeze(n)
+        self.assertTrue(smap.is_frozen())
+        for i in range(n):
+            bitstring = ["0"]*n
+            bitstring[i] = "1" 
+            self.assertEqual(smap.index("".join(bitstring)),i+1)
+        self.assertEqual(smap.index("1"*n),0)
+
+    def test_wildcard_many_surfaces(self):
+        n = 40
+        smap = SVMTK.SubdomainMap(n) 
+        smap.add("1*",1)
+        smap.add("*01",2)
+        smap.add("1"*n,3)
+        smap.erase("1"+"0"*(n-1))
+        self.assertEqual(smap.index("1"*n),1)
+        self.assertEqual(smap.index("1"+"0"*(n-1)),0)
+        self.assertEqual(smap.index("0"*(n-2)+"01"),2)
+        self.assertEqual(smap.index("0"*n),0)
+        self.assertEqual(sorted(smap.get_tags()),[0,1,1,2])
+        self.assertEqual(smap.get_map()["1"+"*"*(n-1)],1)
+        smap.freeze()
+        self.assertTrue(smap.is_frozen())
+        self.assertEqual(smap.index("1"*n),1)
+        self.assertEqual(smap.index("1"+"0"*(n-1)),0)
+        self.assertEqual(smap.index("0"*(n-2)+"01"),2)
+
+    def test_erase_wildcard(self):
+        smap = SVMTK.SubdomainMap(3) 
+        smap.add("1*",1)
+        smap.erase("110")
+        smap.add("*10",2)
+        self.assertEqual(smap.get_map(), {"000":0, "100":1, "101":1, "111":1, "110":2, "010":2})
+
     def test_add_interface(self):        
         smap = SVMTK.SubdomainMap(2) 
         smap.add_interface((1,0),2) 
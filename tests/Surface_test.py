@@ -1,4 +1,7 @@
 import unittest
+import os
+import tempfile
+import numpy
 import SVMTK
 def ellipsoid_function( x, y, z):
   return x*x + 4.*y*y +4.*z*z-1.;
@@ -165,6 +168,11 @@ class Surface_Test(unittest.TestCase):
         a =  surface2.embed(surface1,-0.8)
         self.assertTrue( a[0])
         self.assertEqual( a[1],0) 
+        report = surface2.get_vertex_selection_report()
+        self.assertTrue(len(report) > 0)
+        self.assertEqual(report[-1]["selected_vertices"], 0)
+        for r in report:
+            self.assertTrue(r["reclassified_vertices"] <= r["total_vertices"])
 
     def test_separate_enclosed_surface(self):
         surface1 =SVMTK.Surface()  #BUG
@@ -182,6 +190,65 @@ class Surface_Test(unittest.TestCase):
         surface.collapse_edges() 
         self.assertTrue(surface.num_vertices()>0 and surface.num_faces()>0 and surface.num_edges()>0)
 
+    def test_is_point_inside(self):
+        surface = SVMTK.Surface()   
+        surface.make_cube(-1.,-1.,-1.,1.,1.,1.,1) 
+        points = numpy.array([[0.,0.,0.],[0.5,-0.5,0.5],[2.,0.,0.],[0.,0.,-1.5]])
+        inside = surface.is_point_inside(points)
+        self.assertEqual(inside.dtype, numpy.bool_)
+        self.assertEqual(list(inside), [surface.is_point_inside(SVMTK.Point_3(*point)) for point in points])
+        self.assertEqual(list(inside), [True,True,False,False])
+        surface.clip(0.,0.,1.,0.,True)
+        self.assertFalse(surface.is_point_inside(SVMTK.Point_3(0.5,-0.5,0.5)))
+
+    def test_closest_vertices(self):
+        surface = SVMTK.Surface()   
+        surface.make_cube(-1.,-1.,-1.,1.,1.,1.,1) 
+        points = numpy.array([[1.,1.,1.],[2.,2.,2.],[0.,0.,3.]])
+        indices, distances = surface.get_closest_vertices(points, k=2)
+        self.assertEqual(indices.shape, (3,2))
+        self.assertAlmostEqual(distances[0,0], 0.)
+        self.assertAlmostEqual(distances[1,0], 3**0.5)
+        self.assertTrue((distances[:,0] <= distances[:,1]).all())
+        closest = surface.get_closest_points(SVMTK.Point_3(0.,0.,3.), 1)[0]
+        self.assertAlmostEqual(distances[2,0], ((closest.x())**2 + (closest.y())**2 + (closest.z()-3.)**2)**0.5)
+        offsets, neighbours = surface.get_vertices_within_radius(points, 1.e-6)
+        self.assertEqual(list(offsets), [0,1,1,1])
+        self.assertEqual(neighbours[0], indices[0,0])
+        surface.make_cube(-2.,-2.,-2.,2.,2.,2.,1) 
+        indices, distances = surface.get_closest_vertices(points)
+        self.assertAlmostEqual(distances[1,0], 0.)
+
+    def test_distance_to_points(self):
+        surface = SVMTK.Surface()   
+        surface.make_cube(-1.,-1.,-1.,1.,1.,1.,1) 
+        points = numpy.array([[0.,0.,0.],[0.25,0.25,3.],[2.,0.,0.]])
+        distances, closest_points, faces = surface.distance_to_points(points)
+        self.assertTrue(numpy.allclose(distances, [1.,2.,1.]))
+        self.assertTrue(numpy.allclose(closest_points[1], [0.25,0.25,1.]))
+        self.assertEqual(faces.shape, (3,))
+        signed_distances = surface.distance_to_points(points, signed=True)[0]
+        self.assertTrue(numpy.allclose(signed_distances, [-1.,2.,1.]))
+        self.assertAlmostEqual(surface.distance(SVMTK.Point_3(0.25,0.25,3.)), 2.)
+        self.assertAlmostEqual(surface.signed_distance(SVMTK.Point_3(0.,0.,0.)), -1.)
+
+    def test_signed_distance_field(self):
+        surface = SVMTK.Surface()   
+        surface.make_cube(-1.,-1.,-1.,1.,1.,1.,1) 
+        origin, spacing, dimensions = [-1.45,-1.45,-1.45], [0.1,0.1,0.1], [30,30,30]
+        values = surface.signed_distance_field(origin, spacing, dimensions)
+        self.assertEqual(values.shape, (30,30,30))
+        x = numpy.array(origin) + numpy.array(spacing)*numpy.array([[i,j,k] for k in range(30) for j in range(30) for i in range(30)])
+        expected = surface.distance_to_points(x, signed=True)[0].reshape(30,30,30)
+        self.assertTrue(numpy.allclose(values, expected, atol=1.e-5))
+        occupancy = surface.signed_distance_field(origin, spacing, dimensions, occupancy=True)
+        self.assertTrue(((occupancy == 1) == (values < 0)).all())
+        with tempfile.TemporaryDirectory() as directory:
+            filename = os.path.join(directory, "sdf.nrrd")
+            surface.save_signed_distance_field(filename, origin, spacing, dimensions)
+            with open(filename, "rb") as f:
+                self.assertTrue(f.read().startswith(b"NRRD0004"))
+
     def test_convex_hull(self):
         surface1=SVMTK.Surface()   
         surface1.make_cube(-1.,-1.,-1.,1.,1.,1.,1) 
@@ -3,6 +3,9 @@
 #include "Surface.h"
 #include "Domain.h"
 
+#include <chrono>
+#include <sstream>
+
 
 
 TEST_CASE("Minimum bounding sphere")
@@ -13,3 +16,87 @@ TEST_CASE("Minimum bounding sphere")
     REQUIRE( domain.get_bounding_sphere_radius()==Approx(3).margin(1e-3)) ; // less than 4 larger than 2 ?
 }
 
+
+
+TEST_CASE("Tetrahedron quality")
+{
+    const double s = 1.0/std::sqrt(2.0);
+    Tetrahedron_quality quality = tetrahedron_quality({{ {{1.,0.,-s}}, {{-1.,0.,-s}}, {{0.,1.,s}}, {{0.,-1.,s}} }});
+    REQUIRE( quality.min_dihedral_angle==Approx(70.5288).margin(1e-3) );
+    REQUIRE( quality.max_dihedral_angle==Approx(70.5288).margin(1e-3) );
+    REQUIRE( quality.radius_ratio==Approx(1.0) );
+    REQUIRE( quality.edge_ratio==Approx(1.0) );
+    REQUIRE( quality.aspect_ratio==Approx(1.0) );
+}
+
+TEST_CASE("Labeling oracle benchmark", "[.benchmark]")
+{
+    Surface outer, left, right; 
+    outer.make_sphere(0.,0.,0.,3,0.5); 
+    left.make_sphere(-1.5,0.,0.,1,0.5); 
+    right.make_sphere(1.5,0.,0.,1,0.5); 
+    std::vector<Surface> surfaces = {outer,left,right}; 
+
+    auto map = std::make_shared<SubdomainMap>(3);
+    map->add("100",1);
+    map->add("110",2);
+    map->add("101",3);
+
+    Domain domain(surfaces, map);
+    domain.enable_oracle_statistics();
+    domain.create_mesh(16.);
+    auto statistics = domain.get_oracle_statistics();
+
+    std::cout << "Oracle calls: " << statistics["calls"] 
+              << ", ray casts: " << statistics["ray_casts"] 
+              << ", bbox rejections: " << statistics["bbox_rejections"] 
+              << ", time per call: " << statistics["nanoseconds_per_call"] << " ns" << std::endl; 
+    REQUIRE( statistics["calls"] > 0 );
+    REQUIRE( statistics["ray_casts"] + statistics["bbox_rejections"] == Approx(3*statistics["calls"]) );
+}
+
+
+TEST_CASE("Mesh export benchmark", "[.benchmark]")
+{
+    typedef CGAL::Mesh_3::Medit_pmap_generator<Domain::C3t3,false,false> Generator;
+    
+    for ( std::string filename : {"tests/Data/blobby.off", "tests/Data/elephant.off", "tests/Data/sphere_r6.off"} )
+    {
+        Surface surface(filename); 
+        Domain domain(surface);
+        domain.create_mesh(32.);
+        const Domain::C3t3& c3t3 = domain.get_mesh();
+
+        Generator::Cell_pmap cell_pmap(c3t3);
+        Generator::Facet_pmap facet_pmap(c3t3, cell_pmap); 
+        Generator::Facet_pmap_twice facet_twice_pmap(c3t3, cell_pmap);
+        Generator::Vertex_pmap vertex_pmap(c3t3, cell_pmap, facet_pmap);
+        std::map<std::pair<int,int>,int> facet_map;
+
+        auto start = std::chrono::steady_clock::now();
+        std::ostringstream legacy;
+        output_to_medit_(legacy, c3t3, vertex_pmap, facet_map, cell_pmap, facet_twice_pmap, false, true);
+        double legacy_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        Medit_mesh mesh = domain.export_mesh(true);
+        double export_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::ostringstream current;
+        write_medit_ascii(current, mesh);
+        double current_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << filename << ": " << mesh.number_of_tetrahedra() << " cells, " 
+                  << "output_to_medit_ " << legacy_time << " s, "
+                  << "export " << export_time << " s, export and write " << current_time << " s" << std::endl; 
+
+        std::istringstream legacy_stream(legacy.str());
+        std::string keyword; 
+        std::size_t count;
+        while ( legacy_stream >> keyword )
+        {
+            if ( keyword == "Edges" ) { legacy_stream >> count; REQUIRE( count == mesh.number_of_edges() ); }
+            if ( keyword == "Triangles" ) { legacy_stream >> count; REQUIRE( count == mesh.number_of_triangles() ); }
+            if ( keyword == "Tetrahedra" ) { legacy_stream >> count; REQUIRE( count == mesh.number_of_tetrahedra() ); }
+        }
+    }
+}
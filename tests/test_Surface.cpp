@@ -16,6 +16,15 @@ TEST_CASE("Points inside and outside surface")
     REQUIRE( a.size()==4);
     REQUIRE( b.size()==10);
     REQUIRE( surface.is_point_inside(Point_3(2.1,2.1,2.1))==false );
+
+    const double coordinates[6] = {1.,1.,1., 2.1,2.1,2.1};
+    bool inside[2];
+    surface.is_point_inside(coordinates, 2, inside);
+    REQUIRE( inside[0]==true );
+    REQUIRE( inside[1]==false );
+
+    surface.make_cube(0.,0.,0.,3.0,3.0,3.0,2.0); 
+    REQUIRE( surface.is_point_inside(Point_3(2.1,2.1,2.1))==true );
 }
 
 